@@ -14,6 +14,20 @@ Author #2 : CHAN JIN XUAN (Graphics Design)
 #include <random>
 #include <cstdint>
 #include <string>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <stdexcept>
 
 namespace converter
 {
@@ -50,734 +64,3742 @@ namespace converter
 
 } // namespace converter
 
-namespace gameEng
-{
+//PROFILE_SCOPE("name") times the rest of the enclosing scope as a phase of the frame
+#ifndef DISABLE_FRAME_TIMERS
+#define PROFILE_SCOPE_CONCAT_(a, b) a##b
+#define PROFILE_SCOPE_CONCAT(a, b) PROFILE_SCOPE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) profiler::ScopedTimer PROFILE_SCOPE_CONCAT(scopedTimer, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
 
-    //this namespace contains all the game object and physics engines
+namespace profiler
+{
 
-    bool isUp = false;
-    b2Body *bodyToBeDestroy = nullptr;
-    int currentScore = 0;
+    //this namespace contains the tools to measure where the time of a frame goes
 
-    enum entityName
+    //one physics step as reported by b2World::GetProfile, together with the size of the world at that step
+    struct StepSample
     {
-        GROUND,
-        CHARACTER,
-        STONE_BLOCK,
-        COIN
+        int frame = 0;
+        b2Profile profile = {};
+        int bodyCount = 0;
+        int contactCount = 0;
+        int proxyCount = 0;
     };
 
-    //This entity class is to hold a game objects data like b2Body and its entity type.
-    class Entity
+    const int STEP_FIELD_COUNT = 11;
+    const char *const STEP_FIELD_NAMES[STEP_FIELD_COUNT] = {"step", "collide", "solve", "solveInit", "solveVelocity", "solvePosition", "broadphase", "solveTOI", "bodies", "contacts", "proxies"};
+
+    float getStepField(const StepSample &sample, int field)
     {
+        switch (field)
+        {
+        case 0:
+            return sample.profile.step;
+        case 1:
+            return sample.profile.collide;
+        case 2:
+            return sample.profile.solve;
+        case 3:
+            return sample.profile.solveInit;
+        case 4:
+            return sample.profile.solveVelocity;
+        case 5:
+            return sample.profile.solvePosition;
+        case 6:
+            return sample.profile.broadphase;
+        case 7:
+            return sample.profile.solveTOI;
+        case 8:
+            return (float)sample.bodyCount;
+        case 9:
+            return (float)sample.contactCount;
+        default:
+            return (float)sample.proxyCount;
+        }
+    }
 
-        int entityType;
-        b2Body *entityBody = nullptr;
-        b2World *world = nullptr;
-        float width = 0.0f;
-        float height = 0.0f;
+    //StepRecorder keeps the latest physics steps in a fixed ring buffer. the simulation is the only writer and never locks or allocates,
+    //once the buffer is full the oldest steps are overwritten. the samples are not guarded, so a copy is only consistent
+    //when the simulation is not stepping, the reports read it after the game has ended
+    class StepRecorder
+    {
+
+    private:
+        std::vector<StepSample> samples;
+        size_t mask = 0;
+        std::atomic<uint64_t> written{0};
 
     public:
-        Entity(int entityType, b2Body *entityBody, float width, float height, b2World *world)
+        //the capacity is rounded up to a power of two
+        StepRecorder(size_t capacity)
         {
-            this->entityType = entityType;
-            this->entityBody = entityBody;
-            this->width = width;
-            this->height = height;
-            this->world = world;
+            size_t size = 1;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+            samples.resize(size);
+            mask = size - 1;
         }
 
-        int getEntityType()
+        void record(int frame, b2World *world)
         {
-            return this->entityType;
-        }
+            uint64_t index = written.load(std::memory_order_relaxed);
 
-        b2Body *getEntityBody()
-        {
-            return this->entityBody;
-        }
+            StepSample &sample = samples[index & mask];
+            sample.frame = frame;
+            sample.profile = world->GetProfile();
+            sample.bodyCount = world->GetBodyCount();
+            sample.contactCount = world->GetContactCount();
+            sample.proxyCount = world->GetProxyCount();
 
-        float getWidth()
-        {
-            return this->width;
+            written.store(index + 1, std::memory_order_release);
         }
 
-        float getHeight()
+        //the recorded steps from the oldest to the newest, only call it while the simulation is not stepping
+        std::vector<StepSample> getSamples()
         {
-            return this->height;
+            uint64_t count = written.load(std::memory_order_acquire);
+            uint64_t first = count > samples.size() ? count - samples.size() : 0;
+
+            std::vector<StepSample> result;
+            result.reserve(count - first);
+            for (uint64_t i = first; i < count; i++)
+            {
+                result.push_back(samples[i & mask]);
+            }
+            return result;
         }
 
-        b2World *getWorld()
+        uint64_t getRecordedCount()
         {
-            return this->world;
+            return written.load(std::memory_order_acquire);
         }
     };
 
-    //stores all the created game object to be rendered by SFML
-    std::vector<Entity> entityList;
-
-    //ContactListener class overrides all the method of b2ContactListener for collision detection callbacks by Box2D
-    class ContactListener : public b2ContactListener
+    //nearest rank percentile of an already sorted list
+    float percentile(const std::vector<float> &sorted, float percent)
     {
-    private:
-        virtual void BeginContact(b2Contact *contact) //Callback method when 2 object begin to collide
+        if (sorted.empty())
         {
-
-            b2Body *fixtureA = contact->GetFixtureA()->GetBody();
-            b2Body *fixtureB = contact->GetFixtureB()->GetBody();
-
-            //check if the Character object is colliding with coin object, then destroy the coin object from the b2world
-            for (int i = 0; i < entityList.size(); i++)
-            {
-                if ((entityList[i].getEntityBody() == fixtureA || entityList[i].getEntityBody() == fixtureB) && entityList[i].getEntityType() == COIN)
-                {
-                    bodyToBeDestroy = entityList[i].getEntityBody();
-                    currentScore++; //increase the score value by 1 whenever the character collides with a coin.
-                }
-            }
+            return 0.0f;
         }
+        size_t rank = (size_t)std::ceil(percent / 100.0f * sorted.size());
+        return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
 
-        virtual void EndContact(b2Contact *contact) {}
-        virtual void PreSolve(b2Contact *contact, const b2Manifold *oldManifold) {}
-        virtual void PostSolve(b2Contact *contact, const b2ContactImpulse *impulse) {}
-    };
-
-    //Game class that responsible to create all the game object and also update the position of each of the game object
-    class Game
+    //print p50/p95/p99/max of every recorded field, the times are in millisecond
+    void printStepReport(StepRecorder &recorder, std::ostream &out)
     {
+        std::vector<StepSample> samples = recorder.getSamples();
 
-    private:
-        //NOTE: Box2d use metrics system
-
-        //definition of the attributes for all of the game objects.
-        const float GRAVITY_Y = -10.0f;
-        const float GRAVITY_X = 0.0f;
-
-        const float GROUND_HEIGHT = 10.0f;
-        const float GROUND_WIDTH = 20.0f;
-
-        const float GROUND_START_POSITION_X = 0.0f;
-        const float GROUND_START_POSITION_Y = 0.0f;
+        out << "physics steps: " << samples.size() << " of " << recorder.getRecordedCount() << " recorded" << std::endl;
+        out << "field              p50       p95       p99       max" << std::endl;
 
-        const float STONE_BLOCK_HEIGHT = 2.0f;
-        const float STONE_BLOCK_WIDTH = 4.0f;
+        for (int field = 0; field < STEP_FIELD_COUNT; field++)
+        {
+            std::vector<float> values;
+            values.reserve(samples.size());
+            for (auto &sample : samples)
+            {
+                values.push_back(getStepField(sample, field));
+            }
+            std::sort(values.begin(), values.end());
 
-        const float CHARACTER_HEIGHT = 4.0f;
-        const float CHARACTER_WIDTH = 2.0f;
+            char line[128];
+            std::snprintf(line, sizeof(line), "%-14s %9.3f %9.3f %9.3f %9.3f", STEP_FIELD_NAMES[field], percentile(values, 50.0f), percentile(values, 95.0f), percentile(values, 99.0f), values.empty() ? 0.0f : values.back());
+            out << line << std::endl;
+        }
+    }
 
-        const float COIN_HEIGHT = 1.0f;
-        const float COIN_WIDTH = 1.0f;
+    bool exportStepsCsv(StepRecorder &recorder, const std::string &path)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cerr << "failed to write " << path << std::endl;
+            return false;
+        }
 
-        const float DELTA_TIME = 1.0f / 60.0f;
+        out << "frame";
+        for (int field = 0; field < STEP_FIELD_COUNT; field++)
+        {
+            out << "," << STEP_FIELD_NAMES[field];
+        }
+        out << "\n";
 
-        b2World *myWorld = nullptr;
-        b2Body *pCharacter = nullptr;
-        b2Body *pCoin = nullptr;
+        for (auto &sample : recorder.getSamples())
+        {
+            out << sample.frame;
+            for (int field = 0; field < STEP_FIELD_COUNT; field++)
+            {
+                out << "," << getStepField(sample, field);
+            }
+            out << "\n";
+        }
 
-        sf::Texture groundTexture;
-        sf::Texture stoneTexture;
-        sf::Texture characterTexture;
+        return (bool)out;
+    }
 
-        sf::SoundBuffer soundBufferCoin;
-        sf::Sound coinSound;
+    bool exportStepsJson(StepRecorder &recorder, const std::string &path)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cerr << "failed to write " << path << std::endl;
+            return false;
+        }
 
-    public:
-        Game()
+        out << "[\n";
+        std::vector<StepSample> samples = recorder.getSamples();
+        for (size_t i = 0; i < samples.size(); i++)
         {
-            //load all the texture image from file into the sf::Texture object, so that it can be used later during the rendering
-            groundTexture.loadFromFile("Assets/blue_box.png");
-            groundTexture.setSmooth(true);
-            stoneTexture.loadFromFile("Assets/horizontal_box.png");
-            stoneTexture.setSmooth(true);
-            characterTexture.loadFromFile("Assets/astronaut.png");
+            out << "  {\"frame\": " << samples[i].frame;
+            for (int field = 0; field < STEP_FIELD_COUNT; field++)
+            {
+                out << ", \"" << STEP_FIELD_NAMES[field] << "\": " << getStepField(samples[i], field);
+            }
+            out << (i + 1 < samples.size() ? "},\n" : "}\n");
+        }
+        out << "]\n";
 
-            soundBufferCoin.loadFromFile("Assets/coins.wav");
-            coinSound.setBuffer(soundBufferCoin);
+        return (bool)out;
+    }
 
-            b2Vec2 gravity(GRAVITY_X, GRAVITY_Y);
+    //one named phase of a frame, the phases form a tree by the scopes they were started in, e.g. frame/simulate/step/physics
+    struct Phase
+    {
+        std::string path;
+        const char *name = nullptr;
+        int parent = -1;
+        double frameMs = 0.0;     //time spent so far in the current frame
+        double lastFrameMs = 0.0; //time spent in the last finished frame
+        double totalMs = 0.0;
+        double maxFrameMs = 0.0;
+        uint64_t calls = 0;
+    };
 
-            myWorld = new b2World(gravity);
+    //FrameTimers sums the time of every phase over a frame and keeps the aggregate of all the frames.
+    //while it and the trace are disabled a ScopedTimer only checks two flags, and defining DISABLE_FRAME_TIMERS removes the timers completely.
+    //every thread that draws frames has its own FrameTimers, only setEnabled may be called from another thread
+    class FrameTimers
+    {
 
-            createGround(GROUND_WIDTH, GROUND_HEIGHT, GROUND_START_POSITION_X, GROUND_START_POSITION_Y, true);                                    // top ground
-            createGround(GROUND_WIDTH, GROUND_HEIGHT, GROUND_START_POSITION_X, GROUND_START_POSITION_Y + 25.0f + GROUND_START_POSITION_Y, false); //bottom ground
-            createCharacter(CHARACTER_WIDTH, CHARACTER_HEIGHT, 0.0f - GROUND_WIDTH / 2.0f + CHARACTER_WIDTH / 2.0f, 10.0f);
-            createStoneBlock(30.0f, 2.0f, 25.0f, 25.0f); // stairways
+    private:
+        bool enabled = false;
+        std::atomic<bool> pendingEnabled{false};
+        std::vector<Phase> phases;
+        std::vector<int> stack;
+        uint64_t frameCount = 0;
 
-            //Create the blocks of stone object at the begining of the game scene
-            for (int i = 0; i < 3; i++)
+        int findPhase(int parent, const char *name)
+        {
+            for (size_t i = 0; i < phases.size(); i++)
             {
-                if (i != 2)
-                {
-                    createBlockGroup(10.0f + (10.0f * i), 18.0f - (3.0f * i));
-                }
-                else if (i == 2)
+                if (phases[i].parent == parent && (phases[i].name == name || std::strcmp(phases[i].name, name) == 0))
                 {
-                    createBlockGroup(10.0f + (10.0f * i), 6.978f + (3.0f * i));
-                }
-
-                if (i < 2)
-                {
-                    createBlockGroup(10.0f + (10.0f * i), 7.0f + (3.0f * i));
+                    return (int)i;
                 }
             }
 
-            createStoneBlock(30.0f, 2.0f, 25.0f, 0.0f);
+            Phase phase;
+            phase.name = name;
+            phase.parent = parent;
+            phase.path = parent >= 0 ? phases[parent].path + "/" + name : name;
+            phases.push_back(phase);
+            return (int)phases.size() - 1;
         }
 
-        //obstacles for the gameplay
-        void createObstacles(int initPosX, int initPosY, bool isTop)
+        void printPhases(std::ostream &out, int parent, int depth, bool lastFrameOnly)
         {
-            float obstaclesHeight = 2.0f;
-            if (isTop)
-            {
-                obstaclesHeight = 2.0f;
-            }
-            else
-            {
-                obstaclesHeight = -2.0f;
-            }
-
-            for (int i = 0; i < 2; i++)
+            for (size_t i = 0; i < phases.size(); i++)
             {
-                if (i == 1)
+                if (phases[i].parent != parent)
                 {
-                    createStoneBlock(2.0f, 2.0f, initPosX + 10, initPosY + obstaclesHeight);
+                    continue;
                 }
-                else
+
+                char line[160];
+                if (lastFrameOnly)
                 {
-                    createStoneBlock(12.0f, 2.0f, initPosX + 5, initPosY);
+                    std::snprintf(line, sizeof(line), "%*s%-*s %9.3f ms", depth * 2, "", 28 - depth * 2, phases[i].name, phases[i].lastFrameMs);
                 }
-            }
-
-            for (int i = 0; i < 5; i++)
-            {
-
-                if (!isTop)
+                else
                 {
-                    if (initPosY == 23.0f)
-                    {
-                        createCoin(COIN_WIDTH, COIN_HEIGHT, initPosX + (2.0f * i), initPosY - 2.0f);
-                    }
-                    else if (initPosY == 1.0f)
-                    {
-                        createCoin(COIN_WIDTH, COIN_HEIGHT, initPosX + (2.0f * i), initPosY + 2.0f);
-                    }
-                    else if (initPosY == 14.0f)
-                    {
-                        createCoin(COIN_WIDTH, COIN_HEIGHT, initPosX + (2.0f * i), initPosY + 2.0f);
-                    }
-                    else if (initPosY == 11.0f)
-                    {
-                        createCoin(COIN_WIDTH, COIN_HEIGHT, initPosX + (2.0f * i), initPosY - 2.0f);
-                    }
+                    double average = frameCount > 0 ? phases[i].totalMs / frameCount : 0.0;
+                    std::snprintf(line, sizeof(line), "%*s%-*s %9.3f %9.3f %9.3f %10llu", depth * 2, "", 28 - depth * 2, phases[i].name, average, phases[i].maxFrameMs, phases[i].totalMs, (unsigned long long)phases[i].calls);
                 }
+                out << line << std::endl;
+                printPhases(out, (int)i, depth + 1, lastFrameOnly);
             }
         }
 
-        //create groups of stones blocks to form a large platform
-        void createBlockGroup(int initPosX, int initPosY)
+    public:
+        //the change takes effect with the next frame, so that no frame is measured halfway
+        void setEnabled(bool enabled)
         {
-
-            createStoneBlock(10.0f, 2.0f, initPosX + 10.0f, initPosY);
+            pendingEnabled = enabled;
         }
 
-        b2Body *createGround(float width, float height, float positionX, float positionY, bool isTop)
+        bool isEnabled()
         {
+            return enabled;
+        }
 
-            //create ground body top and bottom
-            b2BodyDef groundBodyDef;
-            groundBodyDef.position.Set(positionX, positionY);
-            //add body (groundBodyBottomDef) to world
-            b2Body *groundBody = myWorld->CreateBody(&groundBodyDef);
-            //define ground body shape
-            b2PolygonShape groundShape;
-            groundShape.SetAsBox(width / 2.0f, height / 2.0f);
-            //create fixture
-            groundBody->CreateFixture(&groundShape, 0.0f);
+        int begin(const char *name)
+        {
+            int phase = findPhase(stack.empty() ? -1 : stack.back(), name);
+            stack.push_back(phase);
+            return phase;
+        }
 
-            float dynamicPositionY = 0.0f;
-            float dynamicPosX = 0.0f;
+        void end(int phase, double elapsedMs)
+        {
+            phases[phase].frameMs += elapsedMs;
+            phases[phase].calls++;
+            stack.pop_back();
+        }
 
-            //to create stairways in between the top and bottom of the ground
-            if (!isTop)
+        //close the current frame, called between two frames when no timer is running
+        void endFrame()
+        {
+            if (enabled)
             {
-                for (int i = 0; i < 5; i++)
+                for (auto &phase : phases)
                 {
-                    dynamicPosX = ((STONE_BLOCK_WIDTH / 2.0f) + positionX) - GROUND_WIDTH / 2.0f + (STONE_BLOCK_WIDTH * i);
-                    if (i <= 2)
-                    {
-                        dynamicPositionY = ((GROUND_HEIGHT / 2.0f) + STONE_BLOCK_HEIGHT / 2.0f) + (STONE_BLOCK_WIDTH / 2.0f * i);
-                    }
-                    else
-                    {
-                        dynamicPositionY -= (STONE_BLOCK_WIDTH / 2.0f);
-                    }
+                    phase.lastFrameMs = phase.frameMs;
+                    phase.totalMs += phase.frameMs;
+                    phase.maxFrameMs = std::max(phase.maxFrameMs, phase.frameMs);
+                    phase.frameMs = 0.0;
+                }
+                frameCount++;
+            }
+            enabled = pendingEnabled;
+        }
 
-                    createStoneBlock(STONE_BLOCK_WIDTH, STONE_BLOCK_HEIGHT, dynamicPosX, dynamicPositionY);
+        //time of the phase in the last finished frame, e.g. getLastFrameMs("frame/simulate"), 0 when it did not run
+        double getLastFrameMs(const std::string &path)
+        {
+            for (auto &phase : phases)
+            {
+                if (phase.path == path)
+                {
+                    return phase.lastFrameMs;
                 }
             }
+            return 0.0;
+        }
 
-            Entity groundEntity(GROUND, groundBody, width, height, myWorld);
+        const std::vector<Phase> &getPhases()
+        {
+            return phases;
+        }
 
-            //push the created object into the vector
-            entityList.push_back(groundEntity);
+        uint64_t getFrameCount()
+        {
+            return frameCount;
+        }
 
-            return groundBody;
+        void printLastFrame(std::ostream &out)
+        {
+            out << "last frame:" << std::endl;
+            printPhases(out, -1, 0, true);
         }
 
-        b2Body *createStoneBlock(float width, float height, float positionX, float positionY)
+        void printReport(std::ostream &out)
         {
+            out << "frames timed: " << frameCount << std::endl;
+            out << "phase                         avg ms    max ms  total ms      calls" << std::endl;
+            printPhases(out, -1, 0, false);
+        }
+    };
 
-            //body definition properties
-            b2BodyDef stoneBlockBodyDef;
-            stoneBlockBodyDef.position.Set(positionX, positionY);
+    FrameTimers frameTimers;  //the frames of the game loop
+    FrameTimers renderTimers; //the frames of the render thread
 
-            //puts the created body into myWorld
-            b2Body *stoneBlockBody = myWorld->CreateBody(&stoneBlockBodyDef);
+    //the timers the scopes of the calling thread are summed in, nullptr when the thread is not timed
+    thread_local FrameTimers *threadFrameTimers = &frameTimers;
 
-            //define the shape
-            b2PolygonShape stoneBlockShape;
-            stoneBlockShape.SetAsBox(width / 2.0f, height / 2.0f);
+    void setThreadFrameTimers(FrameTimers *timers)
+    {
+        threadFrameTimers = timers;
+    }
+
+    //one complete event of the trace, the times are in nanosecond since the trace recorder was created
+    struct TraceEvent
+    {
+        const char *name;
+        int64_t start;
+        int64_t duration;
+    };
+
+    //TraceBuffer holds the events of one thread. only its own thread writes to it, without locks, and it grows by
+    //whole chunks so that the recorded events never move while the exporter reads them
+    class TraceBuffer
+    {
 
-            //define fixture
-            b2FixtureDef b2FixtureDef;
-            b2FixtureDef.friction = 0.0f;
-            b2FixtureDef.shape = &stoneBlockShape;
+    private:
+        static const size_t CHUNK_SIZE = 16384;
+        static const size_t MAX_CHUNKS = 1024;
 
-            stoneBlockBody->CreateFixture(&b2FixtureDef);
+        std::atomic<TraceEvent *> chunks[MAX_CHUNKS];
+        std::atomic<size_t> count{0};
+        uint64_t dropped = 0;
 
-            Entity stoneBlockEntity(STONE_BLOCK, stoneBlockBody, width, height, myWorld);
+    public:
+        uint32_t threadId = 0;
+        std::string threadName;
 
-            //push created object into vector for rendering later on
-            entityList.push_back(stoneBlockEntity);
+        TraceBuffer()
+        {
+            for (auto &chunk : chunks)
+            {
+                chunk.store(nullptr, std::memory_order_relaxed);
+            }
+        }
 
-            return stoneBlockBody;
+        ~TraceBuffer()
+        {
+            for (auto &chunk : chunks)
+            {
+                delete[] chunk.load(std::memory_order_relaxed);
+            }
         }
 
-        b2Body *createCharacter(float width, float height, float positionX, float positionY)
+        void push(const TraceEvent &event)
         {
+            size_t index = count.load(std::memory_order_relaxed);
+            size_t chunkIndex = index / CHUNK_SIZE;
+            if (chunkIndex >= MAX_CHUNKS)
+            {
+                dropped++;
+                return;
+            }
 
-            //body definition
-            b2BodyDef characterBodyDef;
-            characterBodyDef.type = b2_dynamicBody;
-            characterBodyDef.position.Set(positionX, positionY);
-            characterBodyDef.fixedRotation = true;
+            TraceEvent *chunk = chunks[chunkIndex].load(std::memory_order_relaxed);
+            if (!chunk)
+            {
+                chunk = new TraceEvent[CHUNK_SIZE];
+                chunks[chunkIndex].store(chunk, std::memory_order_release);
+            }
 
-            //put created body into myWorld
-            b2Body *characterBody = myWorld->CreateBody(&characterBodyDef);
-            pCharacter = characterBody;
-            characterBody->SetSleepingAllowed(false);
+            chunk[index % CHUNK_SIZE] = event;
+            count.store(index + 1, std::memory_order_release);
+        }
 
-            //define the shape
-            b2PolygonShape characterBodyShape;
-            characterBodyShape.SetAsBox(width / 2.0f, height / 2.0f);
+        size_t size()
+        {
+            return count.load(std::memory_order_acquire);
+        }
 
-            //fixture definition
-            b2FixtureDef characterFixtureDef;
-            characterFixtureDef.shape = &characterBodyShape;
-            characterFixtureDef.density = 3.0f;
-            characterFixtureDef.friction = 0.0f;
+        const TraceEvent &at(size_t index)
+        {
+            return chunks[index / CHUNK_SIZE].load(std::memory_order_acquire)[index % CHUNK_SIZE];
+        }
+    };
 
-            //create the fixture by inserting the fixture definition
-            characterBody->CreateFixture(&characterFixtureDef);
+    //TraceRecorder collects complete events from every thread and writes them in the trace event format,
+    //which can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing
+    class TraceRecorder
+    {
 
-            Entity characterEntity(CHARACTER, characterBody, width, height, myWorld);
+    private:
+        std::atomic<bool> enabled{false};
+        std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
 
-            entityList.push_back(characterEntity);
+        std::mutex buffersMutex; //only taken when a thread records its first event
+        std::vector<std::unique_ptr<TraceBuffer>> buffers;
 
-            return characterBody;
+        TraceBuffer *getThreadBuffer()
+        {
+            thread_local TraceBuffer *threadBuffer = nullptr;
+            if (!threadBuffer)
+            {
+                std::lock_guard<std::mutex> lock(buffersMutex);
+                buffers.emplace_back(new TraceBuffer());
+                threadBuffer = buffers.back().get();
+                threadBuffer->threadId = (uint32_t)buffers.size();
+            }
+            return threadBuffer;
         }
 
-        b2Body *createCoin(float width, float height, float positionX, float positionY)
+    public:
+        void setEnabled(bool enabled)
         {
+            this->enabled.store(enabled, std::memory_order_relaxed);
+        }
 
-            //body definition
-            b2BodyDef coinBodyDef;
-            coinBodyDef.type = b2_kinematicBody;
-            coinBodyDef.position.Set(positionX, positionY);
-            coinBodyDef.fixedRotation = true;
+        bool isEnabled()
+        {
+            return enabled.load(std::memory_order_relaxed);
+        }
 
-            //insert the body definition into myWorld
-            b2Body *coinBody = myWorld->CreateBody(&coinBodyDef);
+        int64_t toTraceTime(std::chrono::steady_clock::time_point time)
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch).count();
+        }
 
-            //define the shape
-            b2PolygonShape coinBodyShape;
-            coinBodyShape.SetAsBox(width / 2.0f, height / 2.0f);
+        //name the calling thread in the trace
+        void setThreadName(const std::string &name)
+        {
+            getThreadBuffer()->threadName = name;
+        }
 
-            //define fixture
-            b2FixtureDef coinFixtureDef;
-            coinFixtureDef.shape = &coinBodyShape;
-            coinFixtureDef.density = 3.0f;
-            coinFixtureDef.friction = 0.0f;
+        void record(const char *name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+        {
+            getThreadBuffer()->push({name, toTraceTime(start), toTraceTime(end) - toTraceTime(start)});
+        }
 
-            //create fixture
-            coinBody->CreateFixture(&coinFixtureDef);
+        //split a b2World::Step that started at the given time into the timings of b2Profile.
+        //Box2D only reports durations, so the parts are laid out in the order b2World::Step runs them
+        void recordStepProfile(std::chrono::steady_clock::time_point stepStart, const b2Profile &profile)
+        {
+            TraceBuffer *buffer = getThreadBuffer();
+            int64_t start = toTraceTime(stepStart);
+            auto toNs = [](float ms) { return (int64_t)(ms * 1000000.0f); };
 
-            Entity coinEntity(COIN, coinBody, width, height, myWorld);
+            buffer->push({"b2.step", start, toNs(profile.step)});
+            buffer->push({"b2.collide", start, toNs(profile.collide)});
 
-            entityList.push_back(coinEntity);
+            int64_t solveStart = start + toNs(profile.collide);
+            buffer->push({"b2.solve", solveStart, toNs(profile.solve)});
+            buffer->push({"b2.solveInit", solveStart, toNs(profile.solveInit)});
+            buffer->push({"b2.solveVelocity", solveStart + toNs(profile.solveInit), toNs(profile.solveVelocity)});
+            buffer->push({"b2.solvePosition", solveStart + toNs(profile.solveInit + profile.solveVelocity), toNs(profile.solvePosition)});
+            buffer->push({"b2.broadphase", solveStart + toNs(profile.solve - profile.broadphase), toNs(profile.broadphase)});
 
-            return coinBody;
+            buffer->push({"b2.solveTOI", solveStart + toNs(profile.solve), toNs(profile.solveTOI)});
         }
 
-        void update(sf::RenderWindow *window)
+        size_t getEventCount()
         {
-            //time steps for the game
-            myWorld->Step(DELTA_TIME, 6, 2);
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            size_t count = 0;
+            for (auto &buffer : buffers)
+            {
+                count += buffer->size();
+            }
+            return count;
+        }
 
-            //destroy the coin body which have collided with the character
-            for (int i = 0; i < entityList.size(); i++)
+        bool exportJson(const std::string &path)
+        {
+            std::ofstream out(path);
+            if (!out)
             {
-                if (bodyToBeDestroy)
-                {
-                    if (entityList[i].getEntityBody() == bodyToBeDestroy)
-                    {
-                        myWorld->DestroyBody(bodyToBeDestroy);
-                        entityList.erase(entityList.begin() + i);
-                        bodyToBeDestroy = nullptr;
-                        if (coinSound.getStatus() != coinSound.Playing)
-                        {
-                            coinSound.play();
-                        }
-                    }
-                }
+                std::cerr << "failed to write " << path << std::endl;
+                return false;
             }
 
-            //Render all the created game entities using SFML
-            for (auto &entity : entityList)
-            {
-
-                int x = converter::meterToPixel(entity.getEntityBody()->GetPosition().x);
-                int y = converter::meterToPixel(converter::box2dToSfmlCoordinateY(entity.getEntityBody()->GetPosition().y));
-                int width = converter::meterToPixel(entity.getWidth());
-                int height = converter::meterToPixel(entity.getHeight());
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
 
-                if (entity.getEntityType() == GROUND)
+            bool first = true;
+            char line[256];
+            for (auto &buffer : buffers)
+            {
+                if (!buffer->threadName.empty())
                 {
-                    sf::RectangleShape ground(sf::Vector2f(width, height));
-                    ground.setTexture(&groundTexture);
-                    ground.setPosition(x, y);
-                    ground.setOrigin(width / 2.0f, height / 2.0f);
-                    window->draw(ground);
+                    std::snprintf(line, sizeof(line), "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", buffer->threadId, buffer->threadName.c_str());
+                    out << line;
+                    first = false;
                 }
-                else if (entity.getEntityType() == CHARACTER)
-                {
 
-                    sf::RectangleShape charact(sf::Vector2f(width, height));
-                    charact.setTexture(&characterTexture);
-                    charact.setPosition(x, y);
-                    charact.setOrigin(width / 2.0f, height / 2.0f);
-                    charact.setRotation(converter::radToDeg(-entity.getEntityBody()->GetAngle()));
-                    window->draw(charact);
-                }
-                else if (entity.getEntityType() == STONE_BLOCK)
+                size_t count = buffer->size();
+                for (size_t i = 0; i < count; i++)
                 {
-
-                    sf::RectangleShape stone(sf::Vector2f(width, height));
-                    stone.setTexture(&stoneTexture);
-                    stone.setPosition(x, y);
-                    stone.setOrigin(width / 2.0f, height / 2.0f);
-                    window->draw(stone);
+                    const TraceEvent &event = buffer->at(i);
+                    std::snprintf(line, sizeof(line), "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}", first ? "" : ",\n", event.name, buffer->threadId, event.start / 1000.0, event.duration / 1000.0);
+                    out << line;
+                    first = false;
                 }
-                else if (entity.getEntityType() == COIN)
-                {
+            }
 
-                    sf::CircleShape coin;
-                    coin.setRadius(width / 2);
-                    coin.setFillColor(sf::Color::Yellow);
-                    coin.setPosition(x, y);
-                    coin.setOrigin(width / 2.0f, height / 2.0f);
-                    window->draw(coin);
-                }
+            out << "\n]}\n";
+            return (bool)out;
+        }
+    };
+
+    TraceRecorder traceRecorder;
+
+    //measures the time until the end of the enclosing scope as a phase of the frame and as a trace event, use it through PROFILE_SCOPE
+    class ScopedTimer
+    {
+
+    private:
+        const char *name = nullptr;
+        int phase = -1;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        ScopedTimer(const char *name)
+        {
+            if (threadFrameTimers && threadFrameTimers->isEnabled())
+            {
+                phase = threadFrameTimers->begin(name);
+            }
+            if (phase >= 0 || traceRecorder.isEnabled())
+            {
+                this->name = name;
+                start = std::chrono::steady_clock::now();
             }
         }
 
-        b2World *getMyWorld()
+        ~ScopedTimer()
         {
-            return myWorld;
+            if (!name)
+            {
+                return;
+            }
+
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            if (phase >= 0)
+            {
+                threadFrameTimers->end(phase, std::chrono::duration<double, std::milli>(end - start).count());
+            }
+            if (traceRecorder.isEnabled())
+            {
+                traceRecorder.record(name, start, end);
+            }
         }
+    };
 
-        b2Body *getCharacter()
+} // namespace profiler
+
+namespace gameEng
+{
+
+    //this namespace contains all the game object and physics engines
+
+    bool isUp = false;
+    int currentScore = 0;
+
+    enum entityName
+    {
+        GROUND,
+        CHARACTER,
+        STONE_BLOCK,
+        COIN
+    };
+
+    enum inputKey
+    {
+        KEY_UP,
+        KEY_DOWN
+    };
+
+    //a single key transition of the player, fed into the simulation instead of raw SFML events
+    struct InputEvent
+    {
+        int key;
+        bool isPressed;
+    };
+
+    //all the player input that happened before one simulation step
+    struct FrameInput
+    {
+        std::vector<InputEvent> events;
+    };
+
+    //the gameplay status after one simulation step, used by the window and the headless runner alike
+    struct FrameState
+    {
+        int frame = 0;
+        int score = 0;
+        int coinsCollected = 0;
+        bool isReady = false;
+        bool isWon = false;
+        bool isLost = false;
+        float characterX = 0.0f; //meter, from the current origin of the world
+        float characterY = 0.0f;
+        float cameraX = 0.0f;
+        double originX = 0.0; //meter the world has been shifted by in the endless mode, add it for the distance from the start
+    };
+
+    const int ENTITY_TYPE_COUNT = 4;
+
+    enum textureName
+    {
+        GROUND_TEXTURE,
+        STONE_TEXTURE,
+        CHARACTER_TEXTURE,
+        COIN_TEXTURE,
+        TEXTURE_COUNT
+    };
+
+    //a stable handle to an entity in the EntityStore, it is also stored in b2BodyUserData::pointer of the entity's body.
+    //the lower bits are the slot index and the upper bits the generation of the slot, so a handle of a removed entity never resolves
+    typedef uint32_t EntityHandle;
+
+    const EntityHandle NO_ENTITY = 0;
+    const int HANDLE_INDEX_BITS = 20;
+    const uint32_t HANDLE_INDEX_MASK = (1u << HANDLE_INDEX_BITS) - 1;
+    const uint32_t HANDLE_GENERATION_MASK = (1u << (32 - HANDLE_INDEX_BITS)) - 1;
+
+    //ComponentTable holds the components of all the entities of one type as structure of arrays,
+    //so the culling and rendering loops stream over contiguous floats instead of chasing every b2Body.
+    //removing an entity moves the last one into its place, so the arrays always stay packed
+    class ComponentTable
+    {
+
+    public:
+        //static entities are pieces of the compound body of their segment, they never move and the renderer bakes them once
+        bool isStatic = true;
+        //the entities of the level belong to the segment they were generated in, the character belongs to none
+        bool isInSegment = true;
+        //pickups have no body and never move either, they are kept in the pickup grid of the store until the character collects them
+        bool isPickup = false;
+
+        std::vector<float> positionX; //meter, copied from the body after every step
+        std::vector<float> positionY;
+        std::vector<float> previousX; //meter, the position before the last step to interpolate the rendering
+        std::vector<float> previousY;
+        std::vector<float> angle;
+        std::vector<float> previousAngle;
+        std::vector<float> halfWidth; //meter
+        std::vector<float> halfHeight;
+        std::vector<float> extentX; //meter, half width of the bounding box of the entity as it was created
+        std::vector<int> textureId;
+        std::vector<b2Body *> body; //static entities share the compound body of their segment, nullptr for the pickups
+        std::vector<uint8_t> markedForDestruction;
+        std::vector<uint32_t> segment; //id of the LevelSegment the entity was generated in
+        std::vector<uint32_t> slot;    //slot of the handle of each entity
+
+        size_t size()
         {
-            return pCharacter;
+            return body.size();
         }
 
-        b2Body *getCoin()
+        void push(b2Body *entityBody, const b2Vec2 &position, float entityAngle, float width, float height, int texture, uint32_t entitySegment, uint32_t entitySlot)
         {
-            return pCoin;
+            positionX.push_back(position.x);
+            positionY.push_back(position.y);
+            previousX.push_back(position.x);
+            previousY.push_back(position.y);
+            angle.push_back(entityAngle);
+            previousAngle.push_back(entityAngle);
+            halfWidth.push_back(width / 2.0f);
+            halfHeight.push_back(height / 2.0f);
+            extentX.push_back(std::abs(width / 2.0f * std::cos(entityAngle)) + std::abs(height / 2.0f * std::sin(entityAngle)));
+            textureId.push_back(texture);
+            body.push_back(entityBody);
+            markedForDestruction.push_back(0);
+            segment.push_back(entitySegment);
+            slot.push_back(entitySlot);
         }
 
-        float getGroundHeight()
+        void removeAt(size_t index)
         {
-            return converter::meterToPixel(GROUND_HEIGHT);
+            size_t last = size() - 1;
+            if (index != last)
+            {
+                positionX[index] = positionX[last];
+                positionY[index] = positionY[last];
+                previousX[index] = previousX[last];
+                previousY[index] = previousY[last];
+                angle[index] = angle[last];
+                previousAngle[index] = previousAngle[last];
+                halfWidth[index] = halfWidth[last];
+                halfHeight[index] = halfHeight[last];
+                extentX[index] = extentX[last];
+                textureId[index] = textureId[last];
+                body[index] = body[last];
+                markedForDestruction[index] = markedForDestruction[last];
+                segment[index] = segment[last];
+                slot[index] = slot[last];
+            }
+            positionX.pop_back();
+            positionY.pop_back();
+            previousX.pop_back();
+            previousY.pop_back();
+            angle.pop_back();
+            previousAngle.pop_back();
+            halfWidth.pop_back();
+            halfHeight.pop_back();
+            extentX.pop_back();
+            textureId.pop_back();
+            body.pop_back();
+            markedForDestruction.pop_back();
+            segment.pop_back();
+            slot.pop_back();
         }
 
-        float getGroundWidth()
+        //move the entities by -shift in x after the origin of the world has been shifted
+        void shiftX(float shift)
         {
-            return converter::meterToPixel(GROUND_WIDTH);
+            for (size_t i = 0; i < size(); i++)
+            {
+                positionX[i] -= shift;
+                previousX[i] -= shift;
+            }
         }
 
-        float getStoneBlockHeight()
+        //copy the transforms of the moving bodies after a physics step, keeping the old ones for the interpolation
+        void syncTransforms()
         {
-            return converter::meterToPixel(STONE_BLOCK_HEIGHT);
+            if (isStatic || isPickup)
+            {
+                return;
+            }
+
+            for (size_t i = 0; i < size(); i++)
+            {
+                const b2Transform &transform = body[i]->GetTransform();
+                previousX[i] = positionX[i];
+                previousY[i] = positionY[i];
+                previousAngle[i] = angle[i];
+                positionX[i] = transform.p.x;
+                positionY[i] = transform.p.y;
+                angle[i] = transform.q.GetAngle();
+            }
         }
 
-        float getStoneBlockWidth()
+        void clear()
         {
-            return converter::meterToPixel(STONE_BLOCK_WIDTH);
+            positionX.clear();
+            positionY.clear();
+            previousX.clear();
+            previousY.clear();
+            angle.clear();
+            previousAngle.clear();
+            halfWidth.clear();
+            halfHeight.clear();
+            extentX.clear();
+            textureId.clear();
+            body.clear();
+            markedForDestruction.clear();
+            segment.clear();
+            slot.clear();
         }
+    };
 
-        float getCharacterHeight()
+    //SpatialGrid buckets the entities that never move into columns of the level, so the entities around a position
+    //are found without scanning every table. the level only runs along x, so a column is enough as a cell
+    class SpatialGrid
+    {
+
+    private:
+        const float CELL_WIDTH = 8.0f; //meter
+
+        std::unordered_map<int32_t, std::vector<EntityHandle>> cells;
+        int32_t originCell = 0; //the columns the origin of the world has been shifted by, so the cells keep their keys
+
+        int32_t getCell(float x)
         {
-            return converter::meterToPixel(CHARACTER_HEIGHT);
+            return (int32_t)std::floor(x / CELL_WIDTH) + originCell;
         }
 
-        float getCharacterWidth()
+    public:
+        //keeps the entities in their columns when the world is shifted by -shift in meter.
+        //the shift must be a whole number of columns, as the REBASE_STEP of the game is
+        void shiftOrigin(float shift)
         {
-            return converter::meterToPixel(CHARACTER_WIDTH);
+            originCell += (int32_t)std::floor(shift / CELL_WIDTH);
         }
-    };
 
-} // namespace gameEng
+        //the entity is put into every column that overlaps [minX, maxX]
+        void insert(EntityHandle handle, float minX, float maxX)
+        {
+            for (int32_t cell = getCell(minX); cell <= getCell(maxX); cell++)
+            {
+                cells[cell].push_back(handle);
+            }
+        }
 
-int main()
-{
-    //get the screen width and height
-    unsigned int screenWidth = sf::VideoMode::getDesktopMode().width;
-    unsigned int screenHeight = sf::VideoMode::getDesktopMode().height;
-    gameEng::Game game;
+        //minX and maxX must be the same as when the entity was inserted
+        void remove(EntityHandle handle, float minX, float maxX)
+        {
+            for (int32_t cell = getCell(minX); cell <= getCell(maxX); cell++)
+            {
+                auto it = cells.find(cell);
+                if (it == cells.end())
+                {
+                    continue;
+                }
 
-    //an random device generator to help generate the obstacles in the game
-    std::random_device rd;
-    std::uniform_int_distribution<int> dist(0, 1);
+                std::vector<EntityHandle> &handles = it->second;
+                auto found = std::find(handles.begin(), handles.end(), handle);
+                if (found != handles.end())
+                {
+                    *found = handles.back();
+                    handles.pop_back();
+                }
+                if (handles.empty())
+                {
+                    cells.erase(it);
+                }
+            }
+        }
 
-    //Create a window
-    sf::RenderWindow *window = new sf::RenderWindow(sf::VideoMode(screenWidth, screenHeight), "Adam's Adventure");
-    window->setFramerateLimit(60);
+        //appends every entity of the columns overlapping [minX, maxX] to result once, the caller still has to test their bounds
+        void query(float minX, float maxX, std::vector<EntityHandle> &result)
+        {
+            size_t first = result.size();
+            for (int32_t cell = getCell(minX); cell <= getCell(maxX); cell++)
+            {
+                auto it = cells.find(cell);
+                if (it != cells.end())
+                {
+                    result.insert(result.end(), it->second.begin(), it->second.end());
+                }
+            }
 
-    //set the viewing position of the window in SFML to fit all the game entity onto screen
-    sf::View view2;
-    view2.setSize(sf::Vector2f(screenWidth, screenHeight));
-    view2.setCenter(screenWidth / 2, screenHeight / 2);
-    view2.move(-450.0f, -(game.getGroundHeight() / 2) + 200.0f);
-    window->setView(view2);
+            //entities wider than a column are in several of them
+            std::sort(result.begin() + first, result.end());
+            result.erase(std::unique(result.begin() + first, result.end()), result.end());
+        }
 
-    //checks on the gameplay status
-    bool moveRight = true;
-    bool nearEnding = false;
-    bool isReady = false;
-    bool isWon = false;
-    bool isLost = false;
+        void clear()
+        {
+            cells.clear();
+            originCell = 0;
+        }
+    };
 
-    //assign a contact listener for collision detection in box2d
-    gameEng::ContactListener contactListener;
-    game.getMyWorld()->SetContactListener(&contactListener);
+    //a chunk of the level that is generated as a unit, like the starting scene or one column of obstacles, and unloaded as a unit.
+    //it owns every entity that stays in place, the moving character belongs to no segment.
+    //its static entities never move, so they are all fixtures of one compound body, and the renderer can bake them once and keep them until the segment is gone
+    struct LevelSegment
+    {
+        uint32_t id = 0;
+        b2Body *staticBody = nullptr; //the compound body of the static entities, destroyed with the last of them
+        bool isComplete = false;  //no more entities will be added
+        float furthestX = 0.0f;   //meter, the largest x position of its entities
+        std::vector<EntityHandle> entities;
+        std::vector<EntityHandle> staticEntities;
+        int liveCount = 0;
+        int liveStaticCount = 0;
+    };
 
-    //define the text display object provided by SFML
-    sf::Text scoreText;
-    sf::Font font;
-    sf::Texture bgTexture;
-    sf::Sprite bgSprite;
+    //EntityStore keeps one ComponentTable per entity type and hands out the stable handles to the entities.
+    //a handle resolves to its table and index in O(1), and the handles stay valid when other entities are removed
+    class EntityStore
+    {
 
-    //load all the textures from file
-    font.loadFromFile("Font/Changa-VariableFont_wght.ttf");
-    bgTexture.loadFromFile("Assets/bg.png");
-    bgSprite.setTexture(bgTexture);
-    bgSprite.setScale(2, 2);
-    bgSprite.setOrigin(bgSprite.getTexture()->getSize().x / 2.0f, bgSprite.getTexture()->getSize().y / 2.0f);
-    scoreText.setFont(font);
-    scoreText.setCharacterSize(220);
-    scoreText.setOrigin(220 / 2.0f, 220 / 2.0f);
-    scoreText.setFillColor(sf::Color::Magenta);
+    private:
+        ComponentTable tables[ENTITY_TYPE_COUNT];
 
-    //play sound effect
-    sf::SoundBuffer soundBufferVictory;
-    soundBufferVictory.loadFromFile("Assets/victory.ogg");
-    sf::Sound victorySound;
-    victorySound.setBuffer(soundBufferVictory);
+        //the pickups are tested against the character every step and drawn every frame, so they are found by position.
+        //the static entities are baked once per segment and only reached through their segment
+        SpatialGrid pickupGrid;
 
-    //Game Loop
-    while (window->isOpen())
-    {
+        std::vector<uint8_t> slotTypes;        //entity type of each slot
+        std::vector<uint32_t> slotItems;       //index in the table of each slot
+        std::vector<uint32_t> slotGenerations; //generation of each slot, starts at 1 so that a handle is never NO_ENTITY
+        std::vector<uint32_t> freeSlots;
 
-        sf::Event event;
+        //the segments that still have entities, ordered by id and so by position, the front one is the furthest behind
+        std::deque<LevelSegment> segments;
+        uint32_t firstSegmentId = 0;
+        uint32_t nextSegmentId = 0;
+        uint32_t firstLoadedSegmentId = 0; //the segments before it are unloading
 
-        while (window->pollEvent(event))
+        EntityHandle makeHandle(uint32_t slot)
         {
+            return (slotGenerations[slot] << HANDLE_INDEX_BITS) | slot;
+        }
 
-            // check the type of the event...
-            switch (event.type)
+    public:
+        //returns false when the handle belongs to an entity that has already been removed
+        bool find(EntityHandle handle, int &entityType, size_t &index)
+        {
+            uint32_t slot = handle & HANDLE_INDEX_MASK;
+            if (handle == NO_ENTITY || slot >= slotItems.size() || makeHandle(slot) != handle)
             {
-            // window closed
-            case sf::Event::Closed:
-                window->close();
-                break;
+                return false;
+            }
+            entityType = slotTypes[slot];
+            index = slotItems[slot];
+            return true;
+        }
 
-            // key pressed
-            case sf::Event::KeyPressed:
+        EntityStore()
+        {
+            tables[CHARACTER].isStatic = false;
+            tables[CHARACTER].isInSegment = false;
+            tables[COIN].isStatic = false;
+            tables[COIN].isPickup = true;
+        }
 
-                //move the object upwards when the up key is being PRESSED
-                if (event.key.code == sf::Keyboard::Up)
-                {
-                    moveRight = false;
-                    isReady = true;
-                    game.getCharacter()->SetLinearVelocity(b2Vec2(0.0f, 10.0f));
-                    game.getMyWorld()->SetGravity(b2Vec2(0.0f, 200.0f));
-                }
-                //move the object downwards key is pressed move the object downward
-                else if (event.key.code == sf::Keyboard::Down)
-                {
-                    moveRight = false;
-                    game.getCharacter()->SetLinearVelocity(b2Vec2(0.0f, -10.0f));
-                    game.getMyWorld()->SetGravity(b2Vec2(0.0f, -200.0f));
-                }
+        //position and angle of the entity in meter and radian, a static entity is one fixture of the body of its segment
+        EntityHandle add(int entityType, b2Body *body, const b2Vec2 &position, float angle, float width, float height, int texture)
+        {
+            uint32_t slot;
+            if (!freeSlots.empty())
+            {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            else
+            {
+                slot = (uint32_t)slotItems.size();
+                slotTypes.push_back(0);
+                slotItems.push_back(0);
+                slotGenerations.push_back(1);
+            }
 
-                break;
+            uint32_t segmentId = nextSegmentId - 1;
+            slotTypes[slot] = (uint8_t)entityType;
+            slotItems[slot] = (uint32_t)tables[entityType].size();
+            tables[entityType].push(body, position, angle, width, height, texture, segmentId, slot);
 
-            // we don't process other types of events
-            default:
-                break;
+            EntityHandle handle = makeHandle(slot);
+            ComponentTable &table = tables[entityType];
+            if (table.isPickup)
+            {
+                size_t index = slotItems[slot];
+                pickupGrid.insert(handle, table.positionX[index] - table.extentX[index], table.positionX[index] + table.extentX[index]);
             }
 
-            //when is key released move the object towards the right
-            if (event.type == sf::Event::KeyReleased)
+            if (table.isInSegment && !segments.empty() && segments.back().id == segmentId)
             {
-                if (event.key.code == sf::Keyboard::Up)
-                {
-                    moveRight = true;
-                }
-                else if (event.key.code == sf::Keyboard::Down)
+                LevelSegment &segment = segments.back();
+                size_t index = slotItems[slot];
+                segment.furthestX = segment.entities.empty() ? table.positionX[index] : std::max(segment.furthestX, table.positionX[index]);
+                segment.entities.push_back(handle);
+                segment.liveCount++;
+                if (table.isStatic)
                 {
-                    moveRight = true;
+                    segment.staticEntities.push_back(handle);
+                    segment.liveStaticCount++;
                 }
             }
+
+            return handle;
         }
 
-        //Starts to destroy all the entity game object after it is being left out of players sight (behind the screen)
-        for (int i = 0; i < gameEng::entityList.size(); i++)
+        //the entities added from now on belong to a new segment
+        void beginSegment()
         {
-            if (converter::pixelToMeter(view2.getCenter().x) - gameEng::entityList[i].getEntityBody()->GetPosition().x > 62.5f && gameEng::entityList[i].getEntityType() != gameEng::CHARACTER)
+            completeSegment();
+
+            LevelSegment segment;
+            segment.id = nextSegmentId++;
+            if (segments.empty())
             {
-                game.getMyWorld()->DestroyBody(gameEng::entityList[i].getEntityBody());
-                gameEng::entityList.erase(gameEng::entityList.begin() + i);
+                firstSegmentId = segment.id;
             }
+            segments.push_back(segment);
         }
 
-        float largestPosX = 0.0f;
-        //get the furtherst rendered game object
-        for (auto &entity : gameEng::entityList)
+        void completeSegment()
         {
-            if (entity.getEntityBody()->GetPosition().x > largestPosX)
+            if (!segments.empty())
             {
-                largestPosX = entity.getEntityBody()->GetPosition().x;
+                segments.back().isComplete = true;
             }
         }
 
-        //a loop to render the obstacles in the game scene as the character travel throughout the game scene
-        if (converter::meterToPixel(largestPosX) - view2.getCenter().x <= 720 && game.getCharacter()->GetPosition().x < 500.0f)
+        //the segment the entities are added to, nullptr between segments
+        LevelSegment *getOpenSegment()
         {
+            if (segments.empty() || segments.back().isComplete || segments.back().id != nextSegmentId - 1)
+            {
+                return nullptr;
+            }
+            return &segments.back();
+        }
 
-            for (int i = 0; i < 10; i++)
+        //returns nullptr when all the entities of the segment are gone
+        LevelSegment *getSegment(uint32_t id)
+        {
+            if (id < firstSegmentId || id - firstSegmentId >= segments.size())
             {
-                if (i == 0 && largestPosX >= 90)
-                {
-                    largestPosX -= 2.0f;
-                }
-                else
-                {
-                    largestPosX += 5.f;
-                }
+                return nullptr;
+            }
+            return &segments[id - firstSegmentId];
+        }
 
-                bool isTop = dist(rd);
+        std::deque<LevelSegment> &getSegments()
+        {
+            return segments;
+        }
 
-                //generate top and bottom obstacles based on the largestPosX point
-                game.createObstacles(largestPosX + (12.f * i), 23.f, dist(rd));
-                if (i == 9)
-                {
-                    game.createObstacles(largestPosX + (12.f * i) + 8.0f, 14.f, false);
-                    game.createObstacles(largestPosX + (12.f * i) + 8.0f, 11.f, true);
-                }
-                else
+        //appends the complete segments that are not unloading yet and lie entirely before x in meter, from the furthest behind.
+        //the segments are ordered by position, so the walk stops at the first one reaching x and costs no more than the result
+        void queryBehind(float x, std::vector<LevelSegment *> &result)
+        {
+            for (uint32_t id = std::max(firstLoadedSegmentId, firstSegmentId); id - firstSegmentId < segments.size(); id++)
+            {
+                LevelSegment &segment = segments[id - firstSegmentId];
+                if (!segment.isComplete || segment.furthestX >= x)
                 {
-                    game.createObstacles(largestPosX + (12.f * i) + 8.0f, 14.f, isTop);
-                    game.createObstacles(largestPosX + (12.f * i) + 8.0f, 11.f, !isTop);
+                    break;
                 }
-                game.createObstacles(largestPosX + (12.f * i), 1.f, dist(rd));
+                result.push_back(&segment);
             }
         }
-        else if (game.getCharacter()->GetPosition().x >= 500.0f && !nearEnding) //if the game is near ending, render the ending game scene
+
+        //the segment must be the first one that is not unloading, as returned by queryBehind.
+        //the segments before firstLoadedSegmentId are the unloading ones, no flag is kept per segment
+        void markUnloading(LevelSegment &segment)
         {
-            nearEnding = true;
-            game.createBlockGroup(largestPosX - 10.0f, 23.f);
-            game.createBlockGroup(largestPosX - 10.0f, 1.f);
-            game.createGround(20.0f, 10.0f, largestPosX + 20.0f, 0.0f, true);
-            game.createGround(20.0f, 10.0f, largestPosX + 20.0f, 0.0f + 25.0f + 0.0f, false);
+            firstLoadedSegmentId = segment.id + 1;
         }
 
-        //keep moving the character towards the right while the game is not won or not lost yet
-        if (moveRight && !isWon && !isLost)
+        //unusedBody is set to the body that no entity uses any more and can be destroyed: the own body of the entity,
+        //or the compound body of its segment once its last static entity is removed
+        bool remove(EntityHandle handle, b2Body *&unusedBody)
         {
-            game.getCharacter()->SetLinearVelocity(b2Vec2(10.0f, 0.0f));
+            unusedBody = nullptr;
+
+            int entityType;
+            size_t index;
+            if (!find(handle, entityType, index))
+            {
+                return false;
+            }
+
+            ComponentTable &table = tables[entityType];
+            uint32_t slot = table.slot[index];
+
+            if (table.isPickup)
+            {
+                pickupGrid.remove(handle, table.positionX[index] - table.extentX[index], table.positionX[index] + table.extentX[index]);
+            }
+
+            LevelSegment *segment = table.isInSegment ? getSegment(table.segment[index]) : nullptr;
+            if (segment)
+            {
+                segment->liveCount--;
+                if (table.isStatic)
+                {
+                    segment->liveStaticCount--;
+                }
+            }
+
+            if (!table.isStatic)
+            {
+                unusedBody = table.body[index];
+            }
+            else if (segment && segment->liveStaticCount == 0)
+            {
+                unusedBody = segment->staticBody;
+                segment->staticBody = nullptr;
+            }
+
+            table.removeAt(index);
+            if (index < table.size())
+            {
+                slotItems[table.slot[index]] = (uint32_t)index;
+            }
+
+            //a new generation makes the old handles of this slot stale
+            slotGenerations[slot] = (slotGenerations[slot] + 1) & HANDLE_GENERATION_MASK;
+            if (slotGenerations[slot] == 0)
+            {
+                slotGenerations[slot] = 1;
+            }
+            freeSlots.push_back(slot);
+
+            //forget the segments at the front that are completely gone
+            while (!segments.empty() && segments.front().isComplete && segments.front().liveCount == 0)
+            {
+                segments.pop_front();
+                firstSegmentId++;
+            }
+
+            return true;
         }
-        //if won or lost, stop moving everything
-        else if (isWon || isLost)
+
+        //move every entity by -shift in x in meter, after b2World::ShiftOrigin has moved their bodies.
+        //the shift must be a whole number of columns of the pickup grid
+        void shiftOrigin(float shift)
         {
-            game.getCharacter()->SetLinearVelocity(b2Vec2(0.0f, 0.0f));
-            game.getMyWorld()->SetGravity(b2Vec2(0.0f, -10.0f));
+            for (auto &table : tables)
+            {
+                table.shiftX(shift);
+            }
+
+            pickupGrid.shiftOrigin(shift);
+
+            for (auto &segment : segments)
+            {
+                segment.furthestX -= shift;
+            }
         }
 
-        //check if the game is lost
-        if (game.getCharacter()->GetPosition().y >= 30.0f || game.getCharacter()->GetPosition().y <= 0.0f)
+        //appends the pickups that may overlap [minX, maxX] in meter, each once, the caller still has to test their bounds
+        void queryPickups(float minX, float maxX, std::vector<EntityHandle> &result)
         {
-            //Lost
-            scoreText.setString("YOU LOST!");
-            scoreText.setPosition(view2.getCenter().x - 550.0f, 220.0f);
-            isLost = true;
+            pickupGrid.query(minX, maxX, result);
         }
 
-        if (converter::pixelToMeter(view2.getCenter().x) - game.getCharacter()->GetPosition().x > converter::pixelToMeter(screenWidth / 2.0f) + 2.0f)
+        //returns -1 when the handle belongs to an entity that has already been removed
+        int getEntityType(EntityHandle handle)
         {
-            //Lost
-            scoreText.setString("YOU LOST!");
-            scoreText.setPosition(view2.getCenter().x - 550.0f, 220.0f);
-            isLost = true;
+            int entityType;
+            size_t index;
+            return find(handle, entityType, index) ? entityType : -1;
         }
 
-        //check if the player has won the game
-        if (game.getCharacter()->GetPosition().x >= 574.0f)
+        //returns false when the entity is gone or has already been marked
+        bool markForDestruction(EntityHandle handle)
         {
-            //won
-            scoreText.setString("YOU WON! " + std::to_string(gameEng::currentScore));
-            scoreText.setPosition(view2.getCenter().x - 550.0f, 420.0f);
-            if (victorySound.getStatus() != victorySound.Playing && !isWon)
+            int entityType;
+            size_t index;
+            if (!find(handle, entityType, index) || tables[entityType].markedForDestruction[index])
             {
-                victorySound.play();
+                return false;
             }
-            isWon = true;
+            tables[entityType].markedForDestruction[index] = 1;
+            return true;
         }
 
-        //whenever the player is ready, start to move the object towards the right
-        if (isReady && !isWon && !isLost)
+        ComponentTable &getTable(int entityType)
         {
-            view2.move(4.3f, 0.0f);
-            window->setView(view2);
+            return tables[entityType];
         }
 
-        window->clear(sf::Color::White);
-
-        //while the player is playing the game, print out the current score
-        if (!isWon && !isLost)
+        //copy the transforms of the non-static bodies after a physics step
+        void syncTransforms()
         {
-            scoreText.setString(std::to_string(gameEng::currentScore));
-            scoreText.setPosition(view2.getCenter().x, 220.0f);
+            for (auto &table : tables)
+            {
+                table.syncTransforms();
+            }
         }
 
-        bgSprite.setPosition(view2.getCenter().x, view2.getCenter().y);
-        window->draw(bgSprite);
-        window->draw(scoreText);
-        game.update(window); //update the game for each loop
-        window->display();
-    }
-
+        //x position of the furthest entity that stays in place in meter, 0 when there is none.
+        //the segments are generated from left to right, so it is the furthest point of the last one
+        float getFurthestX()
+        {
+            for (auto it = segments.rbegin(); it != segments.rend(); ++it)
+            {
+                if (!it->entities.empty())
+                {
+                    return std::max(0.0f, it->furthestX);
+                }
+            }
+            return 0.0f;
+        }
+
+        void clear()
+        {
+            for (auto &table : tables)
+            {
+                table.clear();
+            }
+            slotTypes.clear();
+            slotItems.clear();
+            slotGenerations.clear();
+            freeSlots.clear();
+            pickupGrid.clear();
+            segments.clear();
+            firstSegmentId = 0;
+            nextSegmentId = 0;
+            firstLoadedSegmentId = 0;
+        }
+    };
+
+    //a small PCG32 random number generator (pcg-random.org) for the level generation.
+    //it lives inside the game and is seeded once, so no draw goes to the operating system, and unlike the
+    //std distributions its output is the same with every standard library, so a seed builds the same level everywhere
+    class Random
+    {
+
+    private:
+        uint64_t state = 0;
+        uint64_t increment = 1;
+
+    public:
+        void seed(uint64_t seedValue)
+        {
+            state = 0;
+            increment = (54u << 1u) | 1u;
+            next();
+            state += seedValue;
+            next();
+        }
+
+        uint32_t next()
+        {
+            uint64_t oldState = state;
+            state = oldState * 6364136223846793005ULL + increment;
+            uint32_t xorShifted = (uint32_t)(((oldState >> 18u) ^ oldState) >> 27u);
+            uint32_t rotation = (uint32_t)(oldState >> 59u);
+            return (xorShifted >> rotation) | (xorShifted << ((32u - rotation) & 31u));
+        }
+
+        bool nextBool()
+        {
+            return (next() >> 31) != 0;
+        }
+    };
+
+    //stores all the created game object to be rendered by SFML
+    EntityStore entityStore;
+
+    //add the entity to the entity store and let its body refer back to it, so a body found in the world leads to its entity
+    EntityHandle addEntity(int entityType, b2Body *body, float width, float height, int texture)
+    {
+        EntityHandle handle = entityStore.add(entityType, body, body->GetPosition(), body->GetAngle(), width, height, texture);
+        body->GetUserData().pointer = handle;
+        return handle;
+    }
+
+    //add a static entity that is a piece of the compound body of its segment, its collision is part of the merged outlines of the body
+    EntityHandle addPiece(int entityType, b2Body *segmentBody, const b2Vec2 &position, float width, float height, int texture)
+    {
+        return entityStore.add(entityType, segmentBody, position, 0.0f, width, height, texture);
+    }
+
+    //add a pickup, it has no body and takes no part in the physics, it is only found through the pickup grid of the store
+    EntityHandle addPickup(int entityType, const b2Vec2 &position, float width, float height, int texture)
+    {
+        return entityStore.add(entityType, nullptr, position, 0.0f, width, height, texture);
+    }
+
+    //DestructionQueue collects the entities to be destroyed during a step, each of them only once,
+    //and destroys them together after b2World::Step, the collected coins and the offscreen segments in one batch
+    class DestructionQueue
+    {
+
+    private:
+        std::vector<EntityHandle> pending;
+
+    public:
+        //returns false when the entity is already waiting to be destroyed
+        bool push(EntityHandle handle)
+        {
+            if (!entityStore.markForDestruction(handle))
+            {
+                return false;
+            }
+            pending.push_back(handle);
+            return true;
+        }
+
+        void destroyAll(b2World *world)
+        {
+            for (auto handle : pending)
+            {
+                b2Body *unusedBody = nullptr;
+                if (entityStore.remove(handle, unusedBody) && unusedBody)
+                {
+                    world->DestroyBody(unusedBody);
+                }
+            }
+            pending.clear();
+        }
+
+        void clear()
+        {
+            pending.clear();
+        }
+    };
+
+    DestructionQueue destructionQueue;
+
+    //OutlineBuilder merges axis-aligned boxes that touch or overlap into the outlines of their union, as loops for b2ChainShape.
+    //the boxes are cut along all their edges into a grid, and the sides between a covered and an empty cell are joined into loops.
+    //the outer outlines wind counter-clockwise and the holes clockwise, so the one-sided chains always face out of the solid
+    class OutlineBuilder
+    {
+
+    private:
+        //coordinates closer than this are the same, it also keeps the chain vertices further apart than Box2D requires
+        const float SNAP_DISTANCE = b2_linearSlop;
+
+        std::vector<b2AABB> boxes;
+
+        void sortUnique(std::vector<float> &values)
+        {
+            std::sort(values.begin(), values.end());
+            size_t count = 0;
+            for (float value : values)
+            {
+                if (count == 0 || value - values[count - 1] > SNAP_DISTANCE)
+                {
+                    values[count++] = value;
+                }
+            }
+            values.resize(count);
+        }
+
+        int indexOf(const std::vector<float> &values, float value)
+        {
+            return (int)(std::lower_bound(values.begin(), values.end(), value - SNAP_DISTANCE) - values.begin());
+        }
+
+    public:
+        void add(const b2Vec2 &center, float halfWidth, float halfHeight)
+        {
+            b2AABB box;
+            box.lowerBound.Set(center.x - halfWidth, center.y - halfHeight);
+            box.upperBound.Set(center.x + halfWidth, center.y + halfHeight);
+            boxes.push_back(box);
+        }
+
+        bool isEmpty()
+        {
+            return boxes.empty();
+        }
+
+        void build(std::vector<std::vector<b2Vec2>> &loops)
+        {
+            loops.clear();
+
+            std::vector<float> xs;
+            std::vector<float> ys;
+            for (auto &box : boxes)
+            {
+                xs.push_back(box.lowerBound.x);
+                xs.push_back(box.upperBound.x);
+                ys.push_back(box.lowerBound.y);
+                ys.push_back(box.upperBound.y);
+            }
+            sortUnique(xs);
+            sortUnique(ys);
+
+            //mark the grid cells covered by any box
+            int columns = (int)xs.size() - 1;
+            int rows = (int)ys.size() - 1;
+            std::vector<uint8_t> cells(columns * rows, 0);
+            for (auto &box : boxes)
+            {
+                for (int j = indexOf(ys, box.lowerBound.y); j < indexOf(ys, box.upperBound.y); j++)
+                {
+                    for (int i = indexOf(xs, box.lowerBound.x); i < indexOf(xs, box.upperBound.x); i++)
+                    {
+                        cells[j * columns + i] = 1;
+                    }
+                }
+            }
+            auto isSolid = [&](int i, int j) { return i >= 0 && j >= 0 && i < columns && j < rows && cells[j * columns + i]; };
+
+            //the sides of the covered cells that face an empty cell, directed so that the solid is on their left
+            struct Edge
+            {
+                int startX, startY, endX, endY;
+                bool isUsed;
+            };
+            std::vector<Edge> edges;
+            std::vector<std::vector<int>> outgoing((columns + 1) * (rows + 1));
+            auto addEdge = [&](int startX, int startY, int endX, int endY) {
+                outgoing[startY * (columns + 1) + startX].push_back((int)edges.size());
+                edges.push_back({startX, startY, endX, endY, false});
+            };
+
+            for (int j = 0; j < rows; j++)
+            {
+                for (int i = 0; i < columns; i++)
+                {
+                    if (!isSolid(i, j))
+                    {
+                        continue;
+                    }
+                    if (!isSolid(i, j - 1))
+                    {
+                        addEdge(i, j, i + 1, j);
+                    }
+                    if (!isSolid(i + 1, j))
+                    {
+                        addEdge(i + 1, j, i + 1, j + 1);
+                    }
+                    if (!isSolid(i, j + 1))
+                    {
+                        addEdge(i + 1, j + 1, i, j + 1);
+                    }
+                    if (!isSolid(i - 1, j))
+                    {
+                        addEdge(i, j + 1, i, j);
+                    }
+                }
+            }
+
+            //follow the edges around every loop. where two loops touch at a corner the left turn is taken first,
+            //which keeps them apart, and the corners in the middle of a straight side are left out
+            for (size_t first = 0; first < edges.size(); first++)
+            {
+                if (edges[first].isUsed)
+                {
+                    continue;
+                }
+
+                std::vector<b2Vec2> loop;
+                int current = (int)first;
+                while (true)
+                {
+                    Edge &edge = edges[current];
+                    edge.isUsed = true;
+                    int directionX = edge.endX - edge.startX;
+                    int directionY = edge.endY - edge.startY;
+
+                    int next = -1;
+                    int preferences[3][2] = {{-directionY, directionX}, {directionX, directionY}, {directionY, -directionX}};
+                    for (auto &preference : preferences)
+                    {
+                        for (int candidate : outgoing[edge.endY * (columns + 1) + edge.endX])
+                        {
+                            if (edges[candidate].endX - edges[candidate].startX == preference[0] && edges[candidate].endY - edges[candidate].startY == preference[1])
+                            {
+                                next = candidate;
+                                break;
+                            }
+                        }
+                        if (next >= 0)
+                        {
+                            break;
+                        }
+                    }
+
+                    //a corner, the end of this edge is a vertex of the outline
+                    if (edges[next].endX - edges[next].startX != directionX || edges[next].endY - edges[next].startY != directionY)
+                    {
+                        loop.push_back(b2Vec2(xs[edge.endX], ys[edge.endY]));
+                    }
+
+                    if (next == (int)first)
+                    {
+                        break;
+                    }
+                    current = next;
+                }
+
+                if (loop.size() >= 3)
+                {
+                    loops.push_back(loop);
+                }
+            }
+        }
+
+        void clear()
+        {
+            boxes.clear();
+        }
+    };
+
+    //an entity of the level, described before its body is created
+    struct EntityDescriptor
+    {
+        int type = STONE_BLOCK;
+        float width = 0.0f; //meter
+        float height = 0.0f;
+        float positionX = 0.0f;
+        float positionY = 0.0f;
+    };
+
+    //the entities of one segment of the level, created together
+    struct SegmentLayout
+    {
+        std::vector<EntityDescriptor> entities;
+    };
+
+    //a batch of obstacle columns, each column is a segment
+    struct BatchLayout
+    {
+        std::vector<SegmentLayout> columns;
+        float furthestX = 0.0f; //meter, the furthest entity of the batch, where the next batch starts from
+    };
+
+    //LevelPlanner lays out the batches of obstacle columns on a worker thread, ahead of the game asking for them.
+    //a batch only depends on the batch before it and the random draws, so the same seed still builds the same level
+    class LevelPlanner
+    {
+
+    private:
+        const size_t BATCHES_AHEAD = 2;
+
+        const float COIN_HEIGHT = 1.0f;
+        const float COIN_WIDTH = 1.0f;
+
+        //only used by the worker thread once it is started
+        Random random;
+        float furthestX = 0.0f;
+
+        std::deque<BatchLayout> batches;
+        bool isStopping = false;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::thread worker;
+
+        void addDescriptor(SegmentLayout &segment, int type, float width, float height, float positionX, float positionY)
+        {
+            EntityDescriptor entity;
+            entity.type = type;
+            entity.width = width;
+            entity.height = height;
+            entity.positionX = positionX;
+            entity.positionY = positionY;
+            segment.entities.push_back(entity);
+        }
+
+        //obstacles for the gameplay
+        void planObstacles(SegmentLayout &column, int initPosX, int initPosY, bool isTop)
+        {
+            float obstaclesHeight = 2.0f;
+            if (isTop)
+            {
+                obstaclesHeight = 2.0f;
+            }
+            else
+            {
+                obstaclesHeight = -2.0f;
+            }
+
+            for (int i = 0; i < 2; i++)
+            {
+                if (i == 1)
+                {
+                    addDescriptor(column, STONE_BLOCK, 2.0f, 2.0f, initPosX + 10, initPosY + obstaclesHeight);
+                }
+                else
+                {
+                    addDescriptor(column, STONE_BLOCK, 12.0f, 2.0f, initPosX + 5, initPosY);
+                }
+            }
+
+            for (int i = 0; i < 5; i++)
+            {
+
+                if (!isTop)
+                {
+                    if (initPosY == 23.0f)
+                    {
+                        addDescriptor(column, COIN, COIN_WIDTH, COIN_HEIGHT, initPosX + (2.0f * i), initPosY - 2.0f);
+                    }
+                    else if (initPosY == 1.0f)
+                    {
+                        addDescriptor(column, COIN, COIN_WIDTH, COIN_HEIGHT, initPosX + (2.0f * i), initPosY + 2.0f);
+                    }
+                    else if (initPosY == 14.0f)
+                    {
+                        addDescriptor(column, COIN, COIN_WIDTH, COIN_HEIGHT, initPosX + (2.0f * i), initPosY + 2.0f);
+                    }
+                    else if (initPosY == 11.0f)
+                    {
+                        addDescriptor(column, COIN, COIN_WIDTH, COIN_HEIGHT, initPosX + (2.0f * i), initPosY - 2.0f);
+                    }
+                }
+            }
+        }
+
+        //lay out the next 10 obstacle columns after the furthest point of the last batch
+        void planBatch(BatchLayout &batch)
+        {
+            float largestPosX = furthestX;
+
+            for (int i = 0; i < 10; i++)
+            {
+                if (i == 0 && largestPosX >= 90)
+                {
+                    largestPosX -= 2.0f;
+                }
+                else
+                {
+                    largestPosX += 5.f;
+                }
+
+                batch.columns.emplace_back();
+                SegmentLayout &column = batch.columns.back();
+
+                bool isTop = random.nextBool();
+
+                //generate top and bottom obstacles based on the largestPosX point
+                planObstacles(column, largestPosX + (12.f * i), 23.f, random.nextBool());
+                if (i == 9)
+                {
+                    planObstacles(column, largestPosX + (12.f * i) + 8.0f, 14.f, false);
+                    planObstacles(column, largestPosX + (12.f * i) + 8.0f, 11.f, true);
+                }
+                else
+                {
+                    planObstacles(column, largestPosX + (12.f * i) + 8.0f, 14.f, isTop);
+                    planObstacles(column, largestPosX + (12.f * i) + 8.0f, 11.f, !isTop);
+                }
+                planObstacles(column, largestPosX + (12.f * i), 1.f, random.nextBool());
+            }
+
+            //the columns go from left to right, so the furthest entity is in the last one
+            batch.furthestX = 0.0f;
+            for (auto &entity : batch.columns.back().entities)
+            {
+                batch.furthestX = std::max(batch.furthestX, entity.positionX);
+            }
+            furthestX = batch.furthestX;
+        }
+
+        void run()
+        {
+            profiler::traceRecorder.setThreadName("planner");
+            profiler::setThreadFrameTimers(nullptr);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                condition.wait(lock, [this] { return isStopping || batches.size() < BATCHES_AHEAD; });
+                if (isStopping)
+                {
+                    return;
+                }
+
+                lock.unlock();
+                BatchLayout batch;
+                {
+                    PROFILE_SCOPE("plan");
+                    planBatch(batch);
+                }
+                lock.lock();
+
+                batches.push_back(std::move(batch));
+                condition.notify_all();
+            }
+        }
+
+    public:
+        ~LevelPlanner()
+        {
+            stop();
+        }
+
+        //startX is the furthest point of the level before the first batch, in meter
+        void start(uint32_t seed, float startX)
+        {
+            random.seed(seed);
+            furthestX = startX;
+            worker = std::thread(&LevelPlanner::run, this);
+        }
+
+        //hands out the next batch, only waits for the worker when it has fallen behind
+        void takeBatch(BatchLayout &batch)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return !batches.empty(); });
+            batch = std::move(batches.front());
+            batches.pop_front();
+            condition.notify_all();
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                isStopping = true;
+            }
+            condition.notify_all();
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+    };
+
+    //Game class that responsible to create all the game object and also update the position of each of the game object
+    class Game
+    {
+
+    private:
+        //NOTE: Box2d use metrics system
+
+        //definition of the attributes for all of the game objects.
+        const float GRAVITY_Y = -10.0f;
+        const float GRAVITY_X = 0.0f;
+
+        const float GROUND_HEIGHT = 10.0f;
+        const float GROUND_WIDTH = 20.0f;
+
+        const float GROUND_START_POSITION_X = 0.0f;
+        const float GROUND_START_POSITION_Y = 0.0f;
+
+        const float GROUND_FRICTION = 0.2f; //the default of b2FixtureDef
+
+        const float STONE_BLOCK_HEIGHT = 2.0f;
+        const float STONE_BLOCK_WIDTH = 4.0f;
+
+        const float CHARACTER_HEIGHT = 4.0f;
+        const float CHARACTER_WIDTH = 2.0f;
+
+        //gameplay rules, positions are in meter unless stated otherwise
+        const float CAMERA_SPEED = 4.3f * 60.0f;      //pixel per second
+        const float LOOK_AHEAD_DISTANCE = 720.0f;     //pixel between the camera and the furthest entity before new obstacles are generated
+        const float OFFSCREEN_DESTROY_DISTANCE = 62.5f; //a segment is unloaded once all its entities are this far behind the camera
+        const float OBSTACLES_END_POSITION_X = 500.0f;
+        const float WIN_POSITION_X = 574.0f;
+        const float REBASE_DISTANCE = 256.0f; //how far the camera may get from the origin in the endless mode before the world is shifted back
+        const float REBASE_STEP = 64.0f;      //the shift is a multiple of it, a whole number of meters and of columns of the pickup grid
+        const int SEGMENTS_PER_STEP = 1; //planned segments instantiated per step, so a new batch is spread over several steps
+
+        b2World *myWorld = nullptr;
+        b2Body *pCharacter = nullptr;
+        b2Body *pCoin = nullptr;
+
+        //records the b2Profile of every step when profiling is enabled
+        profiler::StepRecorder *stepRecorder = nullptr;
+
+        //lays out the obstacles from the seed on a worker thread, the same seed always builds the same level
+        LevelPlanner planner;
+
+        //the boxes of the static entities of the segment being generated, merged into chain outlines when it is completed
+        OutlineBuilder groundOutline;
+        OutlineBuilder stoneOutline;
+
+        //the planned segments waiting for their bodies, and the furthest point of the level once they are created.
+        //the planner works from the start of the level, its positions are whole meters so they stay exact far out
+        std::deque<SegmentLayout> pendingSegments;
+        float plannedFurthestX = 0.0f; //meter, from the start of the level
+        std::vector<LevelSegment *> segmentsBehind; //reused by unloadSegments
+        std::vector<EntityHandle> nearbyCoins;      //reused by collectCoins
+
+        //the endless mode never ends the level, and keeps the world near its origin instead
+        bool isEndless = false;
+        double originX = 0.0; //meter, the start of the level is at -originX
+
+        //length of one physics step in second, the game is always advanced in these fixed steps
+        float deltaTime = 1.0f / 60.0f;
+
+        //checks on the gameplay status
+        float viewWidth = 0.0f;       //pixel
+        float cameraX = 0.0f;         //pixel, the center of the view
+        float previousCameraX = 0.0f; //pixel, the center of the view before the last step
+        int frameCount = 0;
+        bool moveRight = true;
+        bool nearEnding = false;
+        bool isReady = false;
+        bool isWon = false;
+        bool isLost = false;
+
+    public:
+        Game(float viewWidth, float stepRate, uint32_t seed, bool isEndless)
+        {
+            //the entity store and score are shared globals, so start every game from a clean state
+            entityStore.clear();
+            destructionQueue.clear();
+            currentScore = 0;
+
+            //the camera starts with the same offset as the view set up by the window
+            this->viewWidth = viewWidth;
+            this->cameraX = viewWidth / 2.0f - 450.0f;
+            this->previousCameraX = this->cameraX;
+            this->deltaTime = 1.0f / stepRate;
+            this->isEndless = isEndless;
+
+            b2Vec2 gravity(GRAVITY_X, GRAVITY_Y);
+
+            myWorld = new b2World(gravity);
+
+            //the starting scene is the first segment of the level
+            entityStore.beginSegment();
+
+            createGround(GROUND_WIDTH, GROUND_HEIGHT, GROUND_START_POSITION_X, GROUND_START_POSITION_Y, true);                                    // top ground
+            createGround(GROUND_WIDTH, GROUND_HEIGHT, GROUND_START_POSITION_X, GROUND_START_POSITION_Y + 25.0f + GROUND_START_POSITION_Y, false); //bottom ground
+            createCharacter(CHARACTER_WIDTH, CHARACTER_HEIGHT, 0.0f - GROUND_WIDTH / 2.0f + CHARACTER_WIDTH / 2.0f, 10.0f);
+            createStoneBlock(30.0f, 2.0f, 25.0f, 25.0f); // stairways
+
+            //Create the blocks of stone object at the begining of the game scene
+            for (int i = 0; i < 3; i++)
+            {
+                if (i != 2)
+                {
+                    createBlockGroup(10.0f + (10.0f * i), 18.0f - (3.0f * i));
+                }
+                else if (i == 2)
+                {
+                    createBlockGroup(10.0f + (10.0f * i), 6.978f + (3.0f * i));
+                }
+
+                if (i < 2)
+                {
+                    createBlockGroup(10.0f + (10.0f * i), 7.0f + (3.0f * i));
+                }
+            }
+
+            createStoneBlock(30.0f, 2.0f, 25.0f, 0.0f);
+
+            completeSegment();
+
+            //the obstacles continue from the end of the starting scene
+            plannedFurthestX = entityStore.getFurthestX();
+            planner.start(seed, plannedFurthestX);
+        }
+
+        ~Game()
+        {
+            planner.stop();
+
+            //the world owns every body, so the entities referring to them are dropped together with it
+            entityStore.clear();
+            delete myWorld;
+        }
+
+        //create groups of stones blocks to form a large platform
+        void createBlockGroup(int initPosX, int initPosY)
+        {
+
+            createStoneBlock(10.0f, 2.0f, initPosX + 10.0f, initPosY);
+        }
+
+        EntityHandle createGround(float width, float height, float positionX, float positionY, bool isTop)
+        {
+
+            //create ground top and bottom, its box is merged into the outline of the grounds of the segment
+            groundOutline.add(b2Vec2(positionX, positionY), width / 2.0f, height / 2.0f);
+
+            float dynamicPositionY = 0.0f;
+            float dynamicPosX = 0.0f;
+
+            //to create stairways in between the top and bottom of the ground
+            if (!isTop)
+            {
+                for (int i = 0; i < 5; i++)
+                {
+                    dynamicPosX = ((STONE_BLOCK_WIDTH / 2.0f) + positionX) - GROUND_WIDTH / 2.0f + (STONE_BLOCK_WIDTH * i);
+                    if (i <= 2)
+                    {
+                        dynamicPositionY = ((GROUND_HEIGHT / 2.0f) + STONE_BLOCK_HEIGHT / 2.0f) + (STONE_BLOCK_WIDTH / 2.0f * i);
+                    }
+                    else
+                    {
+                        dynamicPositionY -= (STONE_BLOCK_WIDTH / 2.0f);
+                    }
+
+                    createStoneBlock(STONE_BLOCK_WIDTH, STONE_BLOCK_HEIGHT, dynamicPosX, dynamicPositionY);
+                }
+            }
+
+            //push the created object into the entity store
+            return addPiece(GROUND, getSegmentBody(), b2Vec2(positionX, positionY), width, height, GROUND_TEXTURE);
+        }
+
+        //the compound static body of the segment being generated, created with its first static entity.
+        //it stays at the origin, so the outlines are placed at their positions in the world
+        b2Body *getSegmentBody()
+        {
+            LevelSegment *segment = entityStore.getOpenSegment();
+            if (!segment->staticBody)
+            {
+                b2BodyDef segmentBodyDef;
+                segment->staticBody = myWorld->CreateBody(&segmentBodyDef);
+            }
+            return segment->staticBody;
+        }
+
+        EntityHandle createStoneBlock(float width, float height, float positionX, float positionY)
+        {
+
+            //the box is merged into the outline of the stones of the segment
+            stoneOutline.add(b2Vec2(positionX, positionY), width / 2.0f, height / 2.0f);
+
+            //push created object into the entity store for rendering later on
+            return addPiece(STONE_BLOCK, getSegmentBody(), b2Vec2(positionX, positionY), width, height, STONE_TEXTURE);
+        }
+
+        //create the chain loops of the merged boxes on the body of the segment
+        void createOutlineFixtures(OutlineBuilder &outline, float friction)
+        {
+            if (outline.isEmpty())
+            {
+                return;
+            }
+
+            std::vector<std::vector<b2Vec2>> loops;
+            outline.build(loops);
+            outline.clear();
+
+            for (auto &loop : loops)
+            {
+                //a loop connects its own ends, so every edge has its ghost vertices and nothing snags at the corners
+                b2ChainShape outlineShape;
+                outlineShape.CreateLoop(loop.data(), (int32)loop.size());
+
+                b2FixtureDef outlineFixtureDef;
+                outlineFixtureDef.shape = &outlineShape;
+                outlineFixtureDef.friction = friction;
+                getSegmentBody()->CreateFixture(&outlineFixtureDef);
+            }
+        }
+
+        //close the segment being generated, the boxes of its grounds and of its stones are merged separately as they have a different friction
+        void completeSegment()
+        {
+            PROFILE_SCOPE("outline");
+
+            createOutlineFixtures(groundOutline, GROUND_FRICTION);
+            createOutlineFixtures(stoneOutline, 0.0f);
+            entityStore.completeSegment();
+        }
+
+        b2Body *createCharacter(float width, float height, float positionX, float positionY)
+        {
+
+            //body definition
+            b2BodyDef characterBodyDef;
+            characterBodyDef.type = b2_dynamicBody;
+            characterBodyDef.position.Set(positionX, positionY);
+            characterBodyDef.fixedRotation = true;
+
+            //put created body into myWorld
+            b2Body *characterBody = myWorld->CreateBody(&characterBodyDef);
+            pCharacter = characterBody;
+            characterBody->SetSleepingAllowed(false);
+
+            //define the shape
+            b2PolygonShape characterBodyShape;
+            characterBodyShape.SetAsBox(width / 2.0f, height / 2.0f);
+
+            //fixture definition
+            b2FixtureDef characterFixtureDef;
+            characterFixtureDef.shape = &characterBodyShape;
+            characterFixtureDef.density = 3.0f;
+            characterFixtureDef.friction = 0.0f;
+
+            //create the fixture by inserting the fixture definition
+            characterBody->CreateFixture(&characterFixtureDef);
+
+            addEntity(CHARACTER, characterBody, width, height, CHARACTER_TEXTURE);
+
+            return characterBody;
+        }
+
+        //a coin is a pickup without a body, the character collects it in collectCoins
+        EntityHandle createCoin(float width, float height, float positionX, float positionY)
+        {
+            return addPickup(COIN, b2Vec2(positionX, positionY), width, height, COIN_TEXTURE);
+        }
+
+        //advance the game by one fixed step: apply the input, stream the level, check the win/lose rules and step the physics.
+        //nothing in here touches SFML, so the game can also be simulated without a window
+        FrameState step(const FrameInput &input)
+        {
+            PROFILE_SCOPE("step");
+
+            int scoreBeforeStep = currentScore;
+
+            applyInput(input);
+            rebaseOrigin();
+            unloadSegments();
+            generateObstacles();
+
+            //keep moving the character towards the right while the game is not won or not lost yet
+            if (moveRight && !isWon && !isLost)
+            {
+                pCharacter->SetLinearVelocity(b2Vec2(10.0f, 0.0f));
+            }
+            //if won or lost, stop moving everything
+            else if (isWon || isLost)
+            {
+                pCharacter->SetLinearVelocity(b2Vec2(0.0f, 0.0f));
+                myWorld->SetGravity(b2Vec2(0.0f, -10.0f));
+            }
+
+            //check if the game is lost
+            if (pCharacter->GetPosition().y >= 30.0f || pCharacter->GetPosition().y <= 0.0f)
+            {
+                isLost = true;
+            }
+
+            if (converter::pixelToMeter(cameraX) - pCharacter->GetPosition().x > converter::pixelToMeter(viewWidth / 2.0f) + 2.0f)
+            {
+                isLost = true;
+            }
+
+            //check if the player has won the game
+            if (!isEndless && pCharacter->GetPosition().x >= WIN_POSITION_X)
+            {
+                isWon = true;
+            }
+
+            //remember where the camera was, so the rendering can interpolate towards the new position
+            previousCameraX = cameraX;
+
+            //whenever the player is ready, start to move the camera towards the right
+            if (isReady && !isWon && !isLost)
+            {
+                cameraX += CAMERA_SPEED * deltaTime;
+            }
+
+            //time steps for the game
+            {
+                PROFILE_SCOPE("physics");
+
+                if (profiler::traceRecorder.isEnabled())
+                {
+                    std::chrono::steady_clock::time_point physicsStart = std::chrono::steady_clock::now();
+                    myWorld->Step(deltaTime, 6, 2);
+                    profiler::traceRecorder.recordStepProfile(physicsStart, myWorld->GetProfile());
+                }
+                else
+                {
+                    myWorld->Step(deltaTime, 6, 2);
+                }
+            }
+
+            if (stepRecorder)
+            {
+                stepRecorder->record(frameCount, myWorld);
+            }
+
+            //bring the positions of the moving entities up to date, the static entities and the pickups never change
+            {
+                PROFILE_SCOPE("sync");
+                entityStore.syncTransforms();
+            }
+
+            collectCoins();
+
+            //destroy the collided coins and the offscreen entities of this step in one batch
+            {
+                PROFILE_SCOPE("destroy");
+                destructionQueue.destroyAll(myWorld);
+            }
+
+            frameCount++;
+
+            FrameState state = getFrameState();
+            state.coinsCollected = currentScore - scoreBeforeStep;
+            return state;
+        }
+
+        FrameState getFrameState()
+        {
+            FrameState state;
+            state.frame = frameCount;
+            state.score = currentScore;
+            state.isReady = isReady;
+            state.isWon = isWon;
+            state.isLost = isLost;
+            state.characterX = pCharacter->GetPosition().x;
+            state.characterY = pCharacter->GetPosition().y;
+            state.cameraX = cameraX;
+            state.originX = originX;
+            return state;
+        }
+
+        void applyInput(const FrameInput &input)
+        {
+            for (auto &inputEvent : input.events)
+            {
+                if (inputEvent.isPressed)
+                {
+                    //move the object upwards when the up key is being PRESSED
+                    if (inputEvent.key == KEY_UP)
+                    {
+                        moveRight = false;
+                        isReady = true;
+                        pCharacter->SetLinearVelocity(b2Vec2(0.0f, 10.0f));
+                        myWorld->SetGravity(b2Vec2(0.0f, 200.0f));
+                    }
+                    //move the object downwards key is pressed move the object downward
+                    else if (inputEvent.key == KEY_DOWN)
+                    {
+                        moveRight = false;
+                        pCharacter->SetLinearVelocity(b2Vec2(0.0f, -10.0f));
+                        myWorld->SetGravity(b2Vec2(0.0f, -200.0f));
+                    }
+                }
+                //when is key released move the object towards the right
+                else
+                {
+                    moveRight = true;
+                }
+            }
+        }
+
+        //shift the world back to the origin once the camera has gone far from it, so that the positions in meter and in pixel
+        //keep the same precision over hours of the endless mode. the shift is a whole number of meters, so the planned positions stay exact,
+        //and of grid columns, so the pickups keep their cells. its cost is linear in the loaded bodies and entities, see the README
+        void rebaseOrigin()
+        {
+            float cameraPositionX = converter::pixelToMeter(cameraX);
+            if (!isEndless || cameraPositionX < REBASE_DISTANCE)
+            {
+                return;
+            }
+
+            PROFILE_SCOPE("rebase");
+
+            float shift = std::floor(cameraPositionX / REBASE_STEP) * REBASE_STEP;
+            myWorld->ShiftOrigin(b2Vec2(shift, 0.0f));
+            entityStore.shiftOrigin(shift);
+            cameraX -= converter::meterToPixel(shift);
+            previousCameraX -= converter::meterToPixel(shift);
+            originX += shift;
+        }
+
+        //the coins have no bodies, the ones whose box overlaps the box of the character are collected.
+        //only the columns of the grid under the character are tested, whatever the number of coins in the level
+        void collectCoins()
+        {
+            PROFILE_SCOPE("pickup");
+
+            b2AABB characterBox;
+            pCharacter->GetFixtureList()->GetShape()->ComputeAABB(&characterBox, pCharacter->GetTransform(), 0);
+
+            nearbyCoins.clear();
+            entityStore.queryPickups(characterBox.lowerBound.x, characterBox.upperBound.x, nearbyCoins);
+            for (EntityHandle handle : nearbyCoins)
+            {
+                int entityType;
+                size_t i;
+                if (!entityStore.find(handle, entityType, i) || entityType != COIN)
+                {
+                    continue;
+                }
+
+                ComponentTable &coins = entityStore.getTable(COIN);
+                b2AABB coinBox;
+                coinBox.lowerBound.Set(coins.positionX[i] - coins.halfWidth[i], coins.positionY[i] - coins.halfHeight[i]);
+                coinBox.upperBound.Set(coins.positionX[i] + coins.halfWidth[i], coins.positionY[i] + coins.halfHeight[i]);
+                if (b2TestOverlap(characterBox, coinBox) && destructionQueue.push(handle))
+                {
+                    currentScore++; //increase the score value by 1 whenever the character collects a coin.
+                }
+            }
+        }
+
+        //Starts to destroy the segments of the level after they are being left out of players sight (behind the screen).
+        //only the front of the segment queue is checked, and the entities are destroyed after the physics step together with the collected coins
+        void unloadSegments()
+        {
+            PROFILE_SCOPE("cull");
+
+            float cameraPositionX = converter::pixelToMeter(cameraX);
+
+            segmentsBehind.clear();
+            entityStore.queryBehind(cameraPositionX - OFFSCREEN_DESTROY_DISTANCE, segmentsBehind);
+            for (LevelSegment *segment : segmentsBehind)
+            {
+                entityStore.markUnloading(*segment);
+                for (EntityHandle handle : segment->entities)
+                {
+                    //the collected coins are gone already
+                    if (entityStore.getEntityType(handle) >= 0)
+                    {
+                        destructionQueue.push(handle);
+                    }
+                }
+            }
+        }
+
+        //generate the obstacles in the game scene as the character travel throughout the game scene.
+        //a batch is taken from the planner in one go, but its bodies are created a few segments per step
+        void generateObstacles()
+        {
+            PROFILE_SCOPE("generate");
+
+            //get the furtherst planned game object
+            float largestPosX = plannedFurthestX - originX;
+
+            if (converter::meterToPixel(largestPosX) - cameraX <= LOOK_AHEAD_DISTANCE && (isEndless || pCharacter->GetPosition().x < OBSTACLES_END_POSITION_X))
+            {
+                BatchLayout batch;
+                {
+                    PROFILE_SCOPE("takeBatch");
+                    planner.takeBatch(batch);
+                }
+
+                for (auto &column : batch.columns)
+                {
+                    pendingSegments.push_back(std::move(column));
+                }
+                plannedFurthestX = batch.furthestX;
+            }
+            //if the game is near ending, render the ending game scene once the last planned columns have been created
+            else if (!isEndless && pCharacter->GetPosition().x >= OBSTACLES_END_POSITION_X && !nearEnding && pendingSegments.empty())
+            {
+                nearEnding = true;
+                entityStore.beginSegment();
+                createBlockGroup(largestPosX - 10.0f, 23.f);
+                createBlockGroup(largestPosX - 10.0f, 1.f);
+                createGround(20.0f, 10.0f, largestPosX + 20.0f, 0.0f, true);
+                createGround(20.0f, 10.0f, largestPosX + 20.0f, 0.0f + 25.0f + 0.0f, false);
+                completeSegment();
+            }
+
+            PROFILE_SCOPE("instantiate");
+            for (int i = 0; i < SEGMENTS_PER_STEP && !pendingSegments.empty(); i++)
+            {
+                entityStore.beginSegment();
+                for (auto &entity : pendingSegments.front().entities)
+                {
+                    if (entity.type == COIN)
+                    {
+                        createCoin(entity.width, entity.height, entity.positionX - originX, entity.positionY);
+                    }
+                    else
+                    {
+                        createStoneBlock(entity.width, entity.height, entity.positionX - originX, entity.positionY);
+                    }
+                }
+                completeSegment();
+                pendingSegments.pop_front();
+            }
+        }
+
+        void setStepRecorder(profiler::StepRecorder *stepRecorder)
+        {
+            this->stepRecorder = stepRecorder;
+        }
+
+        float getDeltaTime()
+        {
+            return deltaTime;
+        }
+
+        float getInterpolatedCameraX(float alpha)
+        {
+            return previousCameraX + (cameraX - previousCameraX) * alpha;
+        }
+
+        b2World *getMyWorld()
+        {
+            return myWorld;
+        }
+
+        b2Body *getCharacter()
+        {
+            return pCharacter;
+        }
+
+        b2Body *getCoin()
+        {
+            return pCoin;
+        }
+
+        float getGroundHeight()
+        {
+            return converter::meterToPixel(GROUND_HEIGHT);
+        }
+
+        float getGroundWidth()
+        {
+            return converter::meterToPixel(GROUND_WIDTH);
+        }
+
+        float getStoneBlockHeight()
+        {
+            return converter::meterToPixel(STONE_BLOCK_HEIGHT);
+        }
+
+        float getStoneBlockWidth()
+        {
+            return converter::meterToPixel(STONE_BLOCK_WIDTH);
+        }
+
+        float getCharacterHeight()
+        {
+            return converter::meterToPixel(CHARACTER_HEIGHT);
+        }
+
+        float getCharacterWidth()
+        {
+            return converter::meterToPixel(CHARACTER_WIDTH);
+        }
+    };
+
+    //TextureAtlas packs the sprite images into one texture, so that the whole playfield is drawn with a single texture bind.
+    //the sprites are placed on shelves and their border pixels are repeated around them, so smoothing never blends in a neighbour
+    //smoothing is a setting of the whole texture, so every sprite is smoothed, the character included
+    class TextureAtlas
+    {
+
+    private:
+        const unsigned int PADDING = 2;
+
+        sf::Texture texture;
+        sf::Image images[TEXTURE_COUNT];
+        sf::FloatRect rects[TEXTURE_COUNT];
+
+        //repeat the outermost pixels of the sprite placed at (x, y) into the padding around it
+        void extrudeBorder(sf::Image &atlas, const sf::Image &image, unsigned int x, unsigned int y)
+        {
+            unsigned int width = image.getSize().x;
+            unsigned int height = image.getSize().y;
+
+            for (unsigned int i = 0; i < width; i++)
+            {
+                atlas.setPixel(x + i, y - 1, image.getPixel(i, 0));
+                atlas.setPixel(x + i, y + height, image.getPixel(i, height - 1));
+            }
+            for (unsigned int i = 0; i < height; i++)
+            {
+                atlas.setPixel(x - 1, y + i, image.getPixel(0, i));
+                atlas.setPixel(x + width, y + i, image.getPixel(width - 1, i));
+            }
+            atlas.setPixel(x - 1, y - 1, image.getPixel(0, 0));
+            atlas.setPixel(x + width, y - 1, image.getPixel(width - 1, 0));
+            atlas.setPixel(x - 1, y + height, image.getPixel(0, height - 1));
+            atlas.setPixel(x + width, y + height, image.getPixel(width - 1, height - 1));
+        }
+
+    public:
+        bool loadFromFile(int spriteId, const std::string &path)
+        {
+            return images[spriteId].loadFromFile(path);
+        }
+
+        void setImage(int spriteId, const sf::Image &image)
+        {
+            images[spriteId] = image;
+        }
+
+        //pack every added image into the atlas texture, the images are released afterwards
+        bool build()
+        {
+            unsigned int maxWidth = std::min(2048u, sf::Texture::getMaximumSize());
+
+            //place the tallest sprites first, every shelf is as tall as its first sprite
+            std::vector<int> order;
+            for (int i = 0; i < TEXTURE_COUNT; i++)
+            {
+                if (images[i].getSize().x > 0)
+                {
+                    order.push_back(i);
+                }
+            }
+            std::sort(order.begin(), order.end(), [this](int a, int b) { return images[a].getSize().y > images[b].getSize().y; });
+
+            sf::Vector2u positions[TEXTURE_COUNT];
+            unsigned int x = PADDING / 2;
+            unsigned int y = PADDING / 2;
+            unsigned int shelfHeight = 0;
+            unsigned int atlasWidth = 0;
+
+            for (int spriteId : order)
+            {
+                sf::Vector2u size = images[spriteId].getSize();
+                if (x + size.x + PADDING / 2 > maxWidth)
+                {
+                    x = PADDING / 2;
+                    y += shelfHeight + PADDING;
+                    shelfHeight = 0;
+                }
+                if (size.x + PADDING > maxWidth)
+                {
+                    std::cerr << "sprite " << spriteId << " is too large for the texture atlas" << std::endl;
+                    return false;
+                }
+
+                positions[spriteId] = sf::Vector2u(x, y);
+                x += size.x + PADDING;
+                shelfHeight = std::max(shelfHeight, size.y);
+                atlasWidth = std::max(atlasWidth, x - PADDING / 2);
+            }
+
+            unsigned int atlasHeight = y + shelfHeight + PADDING / 2;
+            if (atlasHeight > sf::Texture::getMaximumSize())
+            {
+                std::cerr << "the sprites do not fit into one texture atlas" << std::endl;
+                return false;
+            }
+
+            sf::Image atlas;
+            atlas.create(atlasWidth, atlasHeight, sf::Color::Transparent);
+            for (int spriteId : order)
+            {
+                atlas.copy(images[spriteId], positions[spriteId].x, positions[spriteId].y);
+                extrudeBorder(atlas, images[spriteId], positions[spriteId].x, positions[spriteId].y);
+                rects[spriteId] = sf::FloatRect(positions[spriteId].x, positions[spriteId].y, images[spriteId].getSize().x, images[spriteId].getSize().y);
+                images[spriteId] = sf::Image();
+            }
+
+            if (!texture.loadFromImage(atlas))
+            {
+                return false;
+            }
+            texture.setSmooth(true);
+            return true;
+        }
+
+        const sf::Texture &getTexture()
+        {
+            return texture;
+        }
+
+        //area of the sprite in the atlas texture, in pixel
+        const sf::FloatRect &getRect(int spriteId)
+        {
+            return rects[spriteId];
+        }
+    };
+
+    //draw a yellow coin into an image with anti-aliased edges, the coins used to be plain yellow circles
+    sf::Image createCoinImage(unsigned int size)
+    {
+        sf::Image image;
+        image.create(size, size, sf::Color::Transparent);
+
+        float radius = size / 2.0f;
+        for (unsigned int y = 0; y < size; y++)
+        {
+            for (unsigned int x = 0; x < size; x++)
+            {
+                float distance = std::hypot(x + 0.5f - radius, y + 0.5f - radius);
+                float coverage = std::max(0.0f, std::min(1.0f, radius - distance + 0.5f));
+                if (coverage > 0.0f)
+                {
+                    image.setPixel(x, y, sf::Color(255, 255, 0, (sf::Uint8)(coverage * 255.0f)));
+                }
+            }
+        }
+
+        return image;
+    }
+
+    //the transform of an entity after the last two steps, the renderer interpolates between them
+    struct SpriteState
+    {
+        float previousX = 0.0f; //meter
+        float previousY = 0.0f;
+        float previousAngle = 0.0f;
+        float x = 0.0f;
+        float y = 0.0f;
+        float angle = 0.0f;
+        float halfWidth = 0.0f;
+        float halfHeight = 0.0f;
+        int textureId = 0;
+    };
+
+    //the static entities of a level segment that the renderer has not baked yet
+    struct SegmentSnapshot
+    {
+        uint32_t id = 0;
+        std::vector<SpriteState> sprites;
+    };
+
+    //everything needed to draw one frame, copied out of the game so that the render thread never reads it while it is simulated
+    struct FrameSnapshot
+    {
+        float alpha = 0.0f;
+        float cameraX = 0.0f; //pixel, already interpolated
+        FrameState state;     //its originX is where the positions of the snapshot are measured from
+        bool printTimers = false; //print the timers of the render thread after this frame
+        std::vector<SpriteState> sprites; //the entities that are not baked and may be in view
+        std::vector<SegmentSnapshot> newSegments;
+        std::vector<uint32_t> liveSegments; //ids of the segments that still have static entities, ascending
+    };
+
+    //SnapshotBuilder fills the snapshot of a frame from the entity store, on the thread that runs the game
+    class SnapshotBuilder
+    {
+
+    private:
+        uint32_t nextSegmentId = 0; //the segments before it have already been handed to the renderer
+        std::vector<EntityHandle> nearbyEntities;
+
+        SpriteState getSpriteState(ComponentTable &table, size_t i)
+        {
+            SpriteState sprite;
+            sprite.previousX = table.previousX[i];
+            sprite.previousY = table.previousY[i];
+            sprite.previousAngle = table.previousAngle[i];
+            sprite.x = table.positionX[i];
+            sprite.y = table.positionY[i];
+            sprite.angle = table.angle[i];
+            sprite.halfWidth = table.halfWidth[i];
+            sprite.halfHeight = table.halfHeight[i];
+            sprite.textureId = table.textureId[i];
+            return sprite;
+        }
+
+    public:
+        //viewMinX and viewMaxX in meter, the entities in the level are only copied from the columns of the grid the view overlaps
+        void build(FrameSnapshot &snapshot, float viewMinX, float viewMaxX)
+        {
+            snapshot.sprites.clear();
+            snapshot.newSegments.clear();
+            snapshot.liveSegments.clear();
+
+            for (auto &segment : entityStore.getSegments())
+            {
+                if (!segment.isComplete)
+                {
+                    break;
+                }
+                if (segment.liveStaticCount == 0)
+                {
+                    continue;
+                }
+
+                snapshot.liveSegments.push_back(segment.id);
+                if (segment.id < nextSegmentId)
+                {
+                    continue;
+                }
+
+                //the static entities never move, they are only copied once for the renderer to bake
+                snapshot.newSegments.emplace_back();
+                snapshot.newSegments.back().id = segment.id;
+                for (EntityHandle handle : segment.staticEntities)
+                {
+                    int entityType;
+                    size_t i;
+                    if (entityStore.find(handle, entityType, i))
+                    {
+                        snapshot.newSegments.back().sprites.push_back(getSpriteState(entityStore.getTable(entityType), i));
+                    }
+                }
+                nextSegmentId = segment.id + 1;
+            }
+
+            nearbyEntities.clear();
+            entityStore.queryPickups(viewMinX, viewMaxX, nearbyEntities);
+            for (EntityHandle handle : nearbyEntities)
+            {
+                int entityType;
+                size_t i;
+                if (entityStore.find(handle, entityType, i))
+                {
+                    snapshot.sprites.push_back(getSpriteState(entityStore.getTable(entityType), i));
+                }
+            }
+
+            //the entities outside the segments come last, so the character stays in front
+            for (int entityType = 0; entityType < ENTITY_TYPE_COUNT; entityType++)
+            {
+                ComponentTable &table = entityStore.getTable(entityType);
+                if (table.isInSegment)
+                {
+                    continue;
+                }
+
+                for (size_t i = 0; i < table.size(); i++)
+                {
+                    snapshot.sprites.push_back(getSpriteState(table, i));
+                }
+            }
+        }
+    };
+
+    //FrameExchange hands the snapshots from the game loop to the render thread through two buffers.
+    //the game loop fills one while the render thread draws the other, publishing waits until the render thread has let go of the other one
+    class FrameExchange
+    {
+
+    private:
+        FrameSnapshot buffers[2];
+        int writeIndex = 0;
+        bool hasPending = false; //the render thread has not released the last published buffer yet
+        bool isClosed = false;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+
+    public:
+        //only used by the game loop, it is not read by the render thread until it is published
+        FrameSnapshot &getWriteBuffer()
+        {
+            return buffers[writeIndex];
+        }
+
+        void publish()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return !hasPending || isClosed; });
+            hasPending = true;
+            writeIndex = 1 - writeIndex;
+            condition.notify_all();
+        }
+
+        //waits for the next published snapshot, returns nullptr once the exchange is closed
+        const FrameSnapshot *acquire()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return hasPending || isClosed; });
+            if (isClosed)
+            {
+                return nullptr;
+            }
+            return &buffers[1 - writeIndex];
+        }
+
+        //the render thread is done with the acquired snapshot
+        void release()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            hasPending = false;
+            condition.notify_all();
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isClosed = true;
+            condition.notify_all();
+        }
+    };
+
+    //Renderer class that holds the textures and draws the snapshots of the game using SFML.
+    //it is kept apart from the Game class so that the simulation never needs a window or an OpenGL context, and it only reads snapshots so it can run on its own thread.
+    //all the sprites come from one texture atlas: the character and the pickups are batched into one vertex array per frame, while the static
+    //entities of every level segment are baked into a vertex buffer on the graphics card once, so the whole scene takes a handful of draw calls.
+    //only what overlaps the view is submitted: whole segments are skipped by their bounds and the sprites are tested one by one
+    class Renderer
+    {
+
+    private:
+        //the baked static entities of one level segment
+        struct StaticSegment
+        {
+            sf::VertexBuffer buffer;
+            std::vector<sf::Vertex> vertices; //only kept when the graphics card has no vertex buffer support
+            sf::FloatRect bounds;             //pixel, covers all the quads of the segment
+            double originX = 0.0;             //meter, the origin of the world when the segment was baked
+        };
+
+        //the quad of a sprite centered on the origin, entities that do not rotate only need it moved to their position
+        struct SpriteMesh
+        {
+            int width = 0; //pixel
+            int height = 0;
+            sf::Vertex vertices[4];
+        };
+
+        TextureAtlas atlas;
+
+        //reused every frame, clearing it keeps its memory
+        sf::VertexArray dynamicBatch;
+
+        //baked segments by segment id, released together with the last static entity of the segment
+        std::map<uint32_t, std::unique_ptr<StaticSegment>> staticSegments;
+        bool useVertexBuffers = sf::VertexBuffer::isAvailable();
+
+        //indexed by the texture id, coins and the character always have the same size so it is only built again for another size
+        SpriteMesh spriteMeshes[TEXTURE_COUNT];
+
+        //make a quad centered on (x, y), rotated by angle degree, showing the whole sprite
+        void makeQuad(sf::Vertex *quad, float x, float y, float width, float height, float angle, int spriteId)
+        {
+            sf::Vector2f corners[4] = {{-width / 2.0f, -height / 2.0f}, {width / 2.0f, -height / 2.0f}, {width / 2.0f, height / 2.0f}, {-width / 2.0f, height / 2.0f}};
+            const sf::FloatRect &rect = atlas.getRect(spriteId);
+            sf::Vector2f texCoords[4] = {{rect.left, rect.top}, {rect.left + rect.width, rect.top}, {rect.left + rect.width, rect.top + rect.height}, {rect.left, rect.top + rect.height}};
+
+            sf::Transform transform;
+            transform.translate(x, y);
+            if (angle != 0.0f)
+            {
+                transform.rotate(angle);
+            }
+
+            for (int i = 0; i < 4; i++)
+            {
+                quad[i] = sf::Vertex(transform.transformPoint(corners[i]), texCoords[i]);
+            }
+        }
+
+        const SpriteMesh &getSpriteMesh(int spriteId, int width, int height)
+        {
+            SpriteMesh &mesh = spriteMeshes[spriteId];
+            if (mesh.width != width || mesh.height != height)
+            {
+                mesh.width = width;
+                mesh.height = height;
+                makeQuad(mesh.vertices, 0.0f, 0.0f, width, height, 0.0f, spriteId);
+            }
+            return mesh;
+        }
+
+        //add the quad of the sprite to the dynamic batch, unless it is outside of the view
+        void appendSprite(const SpriteState &sprite, float alpha, const sf::FloatRect &viewBounds)
+        {
+            int x = converter::meterToPixel(sprite.previousX + (sprite.x - sprite.previousX) * alpha);
+            int y = converter::meterToPixel(converter::box2dToSfmlCoordinateY(sprite.previousY + (sprite.y - sprite.previousY) * alpha));
+            int width = converter::meterToPixel(sprite.halfWidth * 2.0f);
+            int height = converter::meterToPixel(sprite.halfHeight * 2.0f);
+            float angle = converter::radToDeg(-(sprite.previousAngle + (sprite.angle - sprite.previousAngle) * alpha));
+
+            //coins and the character have a fixed rotation, their quad is the shared mesh of the sprite moved into place
+            if (angle == 0.0f)
+            {
+                if (!viewBounds.intersects(sf::FloatRect(x - width / 2.0f, y - height / 2.0f, width, height)))
+                {
+                    return;
+                }
+
+                const SpriteMesh &mesh = getSpriteMesh(sprite.textureId, width, height);
+                sf::Vector2f offset(x, y);
+                for (const sf::Vertex &vertex : mesh.vertices)
+                {
+                    dynamicBatch.append(sf::Vertex(vertex.position + offset, vertex.texCoords));
+                }
+                return;
+            }
+
+            //the circle around the quad holds it at any angle
+            float radius = std::hypot(width / 2.0f, height / 2.0f);
+            if (!viewBounds.intersects(sf::FloatRect(x - radius, y - radius, radius * 2.0f, radius * 2.0f)))
+            {
+                return;
+            }
+
+            sf::Vertex quad[4];
+            makeQuad(quad, x, y, width, height, angle, sprite.textureId);
+            for (auto &vertex : quad)
+            {
+                dynamicBatch.append(vertex);
+            }
+        }
+
+        //build the vertices of all the static entities of the segment and upload them to the graphics card
+        void bakeSegment(const SegmentSnapshot &segment, double originX)
+        {
+            std::unique_ptr<StaticSegment> staticSegment(new StaticSegment());
+            staticSegment->originX = originX;
+
+            //grounds are drawn below the stones
+            for (int spriteId : {GROUND_TEXTURE, STONE_TEXTURE})
+            {
+                for (const SpriteState &sprite : segment.sprites)
+                {
+                    if (sprite.textureId != spriteId)
+                    {
+                        continue;
+                    }
+
+                    int x = converter::meterToPixel(sprite.x);
+                    int y = converter::meterToPixel(converter::box2dToSfmlCoordinateY(sprite.y));
+                    int width = converter::meterToPixel(sprite.halfWidth * 2.0f);
+                    int height = converter::meterToPixel(sprite.halfHeight * 2.0f);
+
+                    sf::Vertex quad[4];
+                    makeQuad(quad, x, y, width, height, converter::radToDeg(-sprite.angle), sprite.textureId);
+                    staticSegment->vertices.insert(staticSegment->vertices.end(), quad, quad + 4);
+                }
+            }
+
+            if (!staticSegment->vertices.empty())
+            {
+                sf::VertexArray quads(sf::Quads, staticSegment->vertices.size());
+                for (size_t i = 0; i < staticSegment->vertices.size(); i++)
+                {
+                    quads[i] = staticSegment->vertices[i];
+                }
+                staticSegment->bounds = quads.getBounds();
+            }
+
+            if (useVertexBuffers && !staticSegment->vertices.empty())
+            {
+                sf::VertexBuffer &buffer = staticSegment->buffer;
+                buffer.setPrimitiveType(sf::Quads);
+                buffer.setUsage(sf::VertexBuffer::Static);
+                buffer.create(staticSegment->vertices.size());
+                buffer.update(staticSegment->vertices.data());
+                std::vector<sf::Vertex>().swap(staticSegment->vertices);
+            }
+
+            staticSegments[segment.id] = std::move(staticSegment);
+        }
+
+        //bake the segments that have just been generated and release the ones that have been culled
+        void updateStaticSegments(const FrameSnapshot &snapshot)
+        {
+            for (auto it = staticSegments.begin(); it != staticSegments.end();)
+            {
+                if (!std::binary_search(snapshot.liveSegments.begin(), snapshot.liveSegments.end(), it->first))
+                {
+                    it = staticSegments.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            for (auto &segment : snapshot.newSegments)
+            {
+                bakeSegment(segment, snapshot.state.originX);
+            }
+        }
+
+    public:
+        Renderer()
+        {
+            //load all the sprite images from file and pack them into the atlas, so that they can be used later during the rendering.
+            //a sprite that is missing from the atlas is drawn as an empty quad, so every failure is reported
+            const std::pair<int, const char *> spriteFiles[] = {
+                {GROUND_TEXTURE, "Assets/blue_box.png"},
+                {STONE_TEXTURE, "Assets/horizontal_box.png"},
+                {CHARACTER_TEXTURE, "Assets/astronaut.png"}};
+            for (auto &spriteFile : spriteFiles)
+            {
+                if (!atlas.loadFromFile(spriteFile.first, spriteFile.second))
+                {
+                    std::cerr << "could not load the sprite " << spriteFile.second << ", it will not be drawn" << std::endl;
+                }
+            }
+            atlas.setImage(COIN_TEXTURE, createCoinImage(64));
+            if (!atlas.build())
+            {
+                std::cerr << "could not build the texture atlas, the sprites will not be drawn" << std::endl;
+            }
+
+            dynamicBatch.setPrimitiveType(sf::Quads);
+        }
+
+        //the alpha of the snapshot is the fraction of a physics step that has passed since the last step, used to interpolate the sprites
+        void render(sf::RenderWindow *window, const FrameSnapshot &snapshot)
+        {
+            dynamicBatch.clear();
+
+            {
+                PROFILE_SCOPE("bake");
+                updateStaticSegments(snapshot);
+            }
+
+            const sf::View &view = window->getView();
+            sf::FloatRect viewBounds(view.getCenter() - view.getSize() / 2.0f, view.getSize());
+
+            //fill the batch of the sprites that are not baked, in the order of the snapshot
+            {
+                PROFILE_SCOPE("batch");
+
+                for (const SpriteState &sprite : snapshot.sprites)
+                {
+                    appendSprite(sprite, snapshot.alpha, viewBounds);
+                }
+            }
+
+            //one draw call per visible segment and one for all the other entities, all with the atlas texture
+            PROFILE_SCOPE("submit");
+            sf::RenderStates states(&atlas.getTexture());
+
+            for (auto &staticSegment : staticSegments)
+            {
+                //the baked vertices stay where they were, a segment baked before the world was shifted is moved with it when drawn
+                sf::RenderStates segmentStates(states);
+                sf::Vector2f offset(converter::meterToPixel((float)(staticSegment.second->originX - snapshot.state.originX)), 0.0f);
+                segmentStates.transform.translate(offset);
+
+                sf::FloatRect bounds = staticSegment.second->bounds;
+                bounds.left += offset.x;
+                if (!viewBounds.intersects(bounds))
+                {
+                    continue;
+                }
+
+                if (useVertexBuffers)
+                {
+                    window->draw(staticSegment.second->buffer, segmentStates);
+                }
+                else if (!staticSegment.second->vertices.empty())
+                {
+                    window->draw(staticSegment.second->vertices.data(), staticSegment.second->vertices.size(), sf::Quads, segmentStates);
+                }
+            }
+
+            window->draw(dynamicBatch, states);
+        }
+    };
+
+    //HudText is one line of text on top of the game. its layout is only rebuilt when the shown value changes,
+    //and the glyphs it can show are rasterised when it is created, so a new digit never stalls a frame mid-game
+    class HudText
+    {
+
+    private:
+        sf::Text text;
+        bool isShowingValue = false;
+        int value = 0;
+        std::string message;
+
+    public:
+        //characters are all the characters the text will ever show, their glyphs are baked into the font texture right away
+        void create(const sf::Font &font, unsigned int characterSize, const sf::Color &color, const std::string &characters)
+        {
+            for (char character : characters)
+            {
+                font.getGlyph(character, characterSize, false);
+            }
+
+            text.setFont(font);
+            text.setCharacterSize(characterSize);
+            text.setOrigin(characterSize / 2.0f, characterSize / 2.0f);
+            text.setFillColor(color);
+        }
+
+        void setValue(int newValue)
+        {
+            if (isShowingValue && newValue == value)
+            {
+                return;
+            }
+
+            isShowingValue = true;
+            value = newValue;
+            text.setString(std::to_string(newValue));
+        }
+
+        void setMessage(const std::string &newMessage)
+        {
+            if (!isShowingValue && newMessage == message)
+            {
+                return;
+            }
+
+            isShowingValue = false;
+            message = newMessage;
+            text.setString(newMessage);
+        }
+
+        //moving the text only changes its transform, not its layout
+        void setPosition(float x, float y)
+        {
+            text.setPosition(x, y);
+        }
+
+        void draw(sf::RenderWindow *window)
+        {
+            window->draw(text);
+        }
+    };
+
+} // namespace gameEng
+
+namespace replay
+{
+
+    //this namespace contains the recording and playback of a game session.
+    //a replay stores the settings the game was created with and every key transition by the step it was applied on,
+    //so the session can be simulated again step by step without a window
+
+    const char MAGIC[4] = {'A', 'A', 'R', 'P'};
+    const uint32_t VERSION = 8;
+
+    enum replayResult
+    {
+        UNFINISHED,
+        WON,
+        LOST
+    };
+
+    struct RecordedInput
+    {
+        uint32_t frame;
+        uint8_t key;
+        bool isPressed;
+    };
+
+    struct Replay
+    {
+        uint32_t seed = 0;
+        float viewWidth = 0.0f;
+        float stepRate = 0.0f;
+        bool isEndless = false;
+
+        //the outcome of the recorded session, so a playback can check that it reached the same state
+        uint32_t frameCount = 0;
+        int32_t score = 0;
+        uint8_t result = UNFINISHED;
+
+        std::vector<RecordedInput> inputs;
+
+        //remember the input that is applied on the given step
+        void record(int frame, const gameEng::FrameInput &input)
+        {
+            for (auto &inputEvent : input.events)
+            {
+                inputs.push_back({(uint32_t)frame, (uint8_t)inputEvent.key, inputEvent.isPressed});
+            }
+        }
+
+        void finish(const gameEng::FrameState &state)
+        {
+            frameCount = state.frame;
+            score = state.score;
+            result = state.isWon ? WON : state.isLost ? LOST : UNFINISHED;
+        }
+    };
+
+    //all the values are written in little endian so that a replay can be shared between machines
+    void writeUint32(std::ostream &out, uint32_t value)
+    {
+        char bytes[4];
+        for (int i = 0; i < 4; i++)
+        {
+            bytes[i] = (char)((value >> (8 * i)) & 0xFF);
+        }
+        out.write(bytes, 4);
+    }
+
+    uint32_t readUint32(std::istream &in)
+    {
+        unsigned char bytes[4] = {0, 0, 0, 0};
+        in.read((char *)bytes, 4);
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    }
+
+    void writeFloat(std::ostream &out, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        writeUint32(out, bits);
+    }
+
+    float readFloat(std::istream &in)
+    {
+        uint32_t bits = readUint32(in);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    //file layout: magic, version, seed, view width, step rate, endless flag, frame count, score, result, input count,
+    //then 5 bytes per input: the step number and the key in the upper bits with the pressed flag in the lowest bit
+    bool saveToFile(const std::string &path, const Replay &replay)
+    {
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+        {
+            std::cerr << "failed to write replay " << path << std::endl;
+            return false;
+        }
+
+        out.write(MAGIC, 4);
+        writeUint32(out, VERSION);
+        writeUint32(out, replay.seed);
+        writeFloat(out, replay.viewWidth);
+        writeFloat(out, replay.stepRate);
+        out.put((char)(replay.isEndless ? 1 : 0));
+        writeUint32(out, replay.frameCount);
+        writeUint32(out, (uint32_t)replay.score);
+        out.put((char)replay.result);
+        writeUint32(out, (uint32_t)replay.inputs.size());
+
+        for (auto &input : replay.inputs)
+        {
+            writeUint32(out, input.frame);
+            out.put((char)((input.key << 1) | (input.isPressed ? 1 : 0)));
+        }
+
+        return (bool)out;
+    }
+
+    bool loadFromFile(const std::string &path, Replay &replay)
+    {
+        std::ifstream in(path, std::ios::binary);
+        char magic[4] = {0, 0, 0, 0};
+        in.read(magic, 4);
+        if (!in || std::memcmp(magic, MAGIC, 4) != 0 || readUint32(in) != VERSION)
+        {
+            std::cerr << path << " is not a replay of this version of the game" << std::endl;
+            return false;
+        }
+
+        replay.seed = readUint32(in);
+        replay.viewWidth = readFloat(in);
+        replay.stepRate = readFloat(in);
+        replay.isEndless = in.get() == 1;
+        replay.frameCount = readUint32(in);
+        replay.score = (int32_t)readUint32(in);
+        replay.result = (uint8_t)in.get();
+
+        uint32_t inputCount = readUint32(in);
+        replay.inputs.clear();
+        for (uint32_t i = 0; i < inputCount && in; i++)
+        {
+            RecordedInput input;
+            input.frame = readUint32(in);
+            uint8_t packed = (uint8_t)in.get();
+            input.key = packed >> 1;
+            input.isPressed = (packed & 1) != 0;
+            replay.inputs.push_back(input);
+        }
+
+        if (!in)
+        {
+            std::cerr << "replay " << path << " is truncated" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+} // namespace replay
+
+//settings of one run of the game, read from the command line
+struct LaunchOptions
+{
+    bool headless = false;
+    float viewWidth = 1920.0f;
+    int maxFrames = 60 * 60 * 10;
+    float stepRate = 60.0f;
+    unsigned int frameRateLimit = 0;
+    uint32_t seed = 0;
+    std::string recordPath;
+    std::string replayPath;
+    bool profile = false;
+    std::string profileCsvPath;
+    std::string profileJsonPath;
+    bool timers = false;
+    std::string tracePath;
+    bool endless = false;
+};
+
+//draw the published snapshots until the exchange is closed. it runs on its own thread, so the game loop simulates the next frame
+//while this one is drawn and swapped. the game loop keeps polling the events of the window, this thread is the only one drawing to it
+void renderFrames(sf::RenderWindow *window, gameEng::FrameExchange *exchange, sf::View view)
+{
+    profiler::traceRecorder.setThreadName("render");
+    profiler::setThreadFrameTimers(&profiler::renderTimers);
+    window->setActive(true);
+
+    gameEng::Renderer renderer;
+
+    //define the text display object of the score
+    gameEng::HudText scoreText;
+    sf::Font font;
+    sf::Texture bgTexture;
+    sf::Sprite bgSprite;
+
+    //load all the textures from file
+    font.loadFromFile("Font/Changa-VariableFont_wght.ttf");
+    bgTexture.loadFromFile("Assets/bg.png");
+    bgSprite.setTexture(bgTexture);
+    bgSprite.setScale(2, 2);
+    bgSprite.setOrigin(bgSprite.getTexture()->getSize().x / 2.0f, bgSprite.getTexture()->getSize().y / 2.0f);
+    scoreText.create(font, 220, sf::Color::Magenta, "0123456789 YOUWNLST!");
+
+    bool wasWon = false;
+
+    while (const gameEng::FrameSnapshot *snapshot = exchange->acquire())
+    {
+        profiler::renderTimers.endFrame();
+        PROFILE_SCOPE("frame");
+
+        const gameEng::FrameState &state = snapshot->state;
+
+        //follow the camera of the game
+        view.setCenter(snapshot->cameraX, view.getCenter().y);
+        window->setView(view);
+
+        if (state.isLost)
+        {
+            //Lost
+            scoreText.setMessage("YOU LOST!");
+            scoreText.setPosition(view.getCenter().x - 550.0f, 220.0f);
+        }
+
+        if (state.isWon)
+        {
+            //won
+            if (!wasWon)
+            {
+                scoreText.setMessage("YOU WON! " + std::to_string(state.score));
+            }
+            scoreText.setPosition(view.getCenter().x - 550.0f, 420.0f);
+            wasWon = true;
+        }
+
+        //while the player is playing the game, print out the current score
+        if (!state.isWon && !state.isLost)
+        {
+            scoreText.setValue(state.score);
+            scoreText.setPosition(view.getCenter().x, 220.0f);
+        }
+
+        {
+            PROFILE_SCOPE("draw");
+
+            window->clear(sf::Color::White);
+            bgSprite.setPosition(view.getCenter().x, view.getCenter().y);
+            window->draw(bgSprite);
+            scoreText.draw(window);
+            renderer.render(window, *snapshot);
+        }
+
+        //the draw calls have been submitted, so the game loop may fill this buffer again
+        bool printTimers = snapshot->printTimers;
+        exchange->release();
+
+        {
+            PROFILE_SCOPE("display");
+            window->display();
+        }
+
+        if (printTimers && profiler::renderTimers.isEnabled())
+        {
+            std::cout << "render thread ";
+            profiler::renderTimers.printLastFrame(std::cout);
+        }
+    }
+
+    profiler::renderTimers.endFrame();
+    window->setActive(false);
+}
+
+//run the game in a window, translating the keyboard events into the simulation input.
+//the simulation is advanced in fixed steps of real time while the rendering runs at its own rate and interpolates between the steps.
+//every frame the loop publishes a snapshot of the game to the render thread and goes on with the next frame while it is drawn
+int runWindowed(const LaunchOptions &options, profiler::StepRecorder *stepRecorder)
+{
+    //most real time in second caught up after one rendered frame, so that a long hitch is not followed by a burst of catch-up steps.
+    //it is a time and not a step count, so any step rate keeps the game at full speed
+    const float MAX_FRAME_TIME = 0.25f;
+
+    //get the screen width and height
+    unsigned int screenWidth = sf::VideoMode::getDesktopMode().width;
+    unsigned int screenHeight = sf::VideoMode::getDesktopMode().height;
+    gameEng::Game game(screenWidth, options.stepRate, options.seed, options.endless);
+    game.setStepRecorder(stepRecorder);
+
+    //remember the whole session when it should be recorded
+    replay::Replay recording;
+    recording.seed = options.seed;
+    recording.viewWidth = screenWidth;
+    recording.stepRate = options.stepRate;
+    recording.isEndless = options.endless;
+
+    //Create a window, rendering is synchronised to the display unless a frame rate limit is given
+    sf::RenderWindow *window = new sf::RenderWindow(sf::VideoMode(screenWidth, screenHeight), "Adam's Adventure");
+    window->setVerticalSyncEnabled(options.frameRateLimit == 0);
+
+    //set the viewing position of the window in SFML to fit all the game entity onto screen
+    sf::View view2;
+    view2.setSize(sf::Vector2f(screenWidth, screenHeight));
+    view2.setCenter(screenWidth / 2, screenHeight / 2);
+    view2.move(-450.0f, -(game.getGroundHeight() / 2) + 200.0f);
+
+    //hand the window over to the render thread, this thread only polls its events from now on
+    gameEng::FrameExchange exchange;
+    gameEng::SnapshotBuilder snapshotBuilder;
+    window->setActive(false);
+    std::thread renderThread(renderFrames, window, &exchange, view2);
+
+    //play sound effect
+    sf::SoundBuffer soundBufferVictory;
+    soundBufferVictory.loadFromFile("Assets/victory.ogg");
+    sf::Sound victorySound;
+    victorySound.setBuffer(soundBufferVictory);
+
+    sf::SoundBuffer soundBufferCoin;
+    soundBufferCoin.loadFromFile("Assets/coins.wav");
+    sf::Sound coinSound;
+    coinSound.setBuffer(soundBufferCoin);
+
+    bool wasWon = false;
+    bool isRunning = true;
+    bool printRenderTimers = false;
+
+    gameEng::FrameState state = game.getFrameState();
+    gameEng::FrameInput input;
+    sf::Clock frameClock;
+    sf::Clock limiterClock;
+    float accumulator = 0.0f;
+
+    //Game Loop
+    while (isRunning)
+    {
+        profiler::frameTimers.endFrame();
+        PROFILE_SCOPE("frame");
+
+        sf::Event event;
+
+        {
+            PROFILE_SCOPE("events");
+
+            while (window->pollEvent(event))
+            {
+
+                // check the type of the event...
+                switch (event.type)
+                {
+                // window closed, it is closed once the render thread has stopped drawing to it
+                case sf::Event::Closed:
+                    isRunning = false;
+                    break;
+
+                // key pressed
+                case sf::Event::KeyPressed:
+
+                    if (event.key.code == sf::Keyboard::Up)
+                    {
+                        input.events.push_back({gameEng::KEY_UP, true});
+                    }
+                    else if (event.key.code == sf::Keyboard::Down)
+                    {
+                        input.events.push_back({gameEng::KEY_DOWN, true});
+                    }
+                    //print where the time of the last frame went
+                    else if (event.key.code == sf::Keyboard::F1 && profiler::frameTimers.isEnabled())
+                    {
+                        profiler::frameTimers.printLastFrame(std::cout);
+                        printRenderTimers = true;
+                    }
+                    //start or stop capturing the trace
+                    else if (event.key.code == sf::Keyboard::F2)
+                    {
+                        profiler::traceRecorder.setEnabled(!profiler::traceRecorder.isEnabled());
+                    }
+
+                    break;
+
+                // key released
+                case sf::Event::KeyReleased:
+
+                    if (event.key.code == sf::Keyboard::Up)
+                    {
+                        input.events.push_back({gameEng::KEY_UP, false});
+                    }
+                    else if (event.key.code == sf::Keyboard::Down)
+                    {
+                        input.events.push_back({gameEng::KEY_DOWN, false});
+                    }
+
+                    break;
+
+                // we don't process other types of events
+                default:
+                    break;
+                }
+            }
+        }
+
+        //run as many fixed physics steps as the real time passed since the last frame needs
+        accumulator += std::min(frameClock.restart().asSeconds(), MAX_FRAME_TIME);
+
+        int coinsCollected = 0;
+        {
+            PROFILE_SCOPE("simulate");
+
+            while (accumulator >= game.getDeltaTime())
+            {
+                recording.record(state.frame, input);
+                state = game.step(input); //update the game for each step
+                input.events.clear();     //the input is only applied once, events that arrive without a step wait for the next one
+                coinsCollected += state.coinsCollected;
+                accumulator -= game.getDeltaTime();
+            }
+        }
+
+        float alpha = accumulator / game.getDeltaTime();
+
+        //follow the camera of the game
+        view2.setCenter(game.getInterpolatedCameraX(alpha), view2.getCenter().y);
+
+        if (coinsCollected > 0 && coinSound.getStatus() != coinSound.Playing)
+        {
+            coinSound.play();
+        }
+
+        if (state.isWon && !wasWon && victorySound.getStatus() != victorySound.Playing)
+        {
+            victorySound.play();
+        }
+        wasWon = state.isWon;
+
+        {
+            PROFILE_SCOPE("snapshot");
+
+            gameEng::FrameSnapshot &snapshot = exchange.getWriteBuffer();
+            snapshot.alpha = alpha;
+            snapshot.cameraX = view2.getCenter().x;
+            snapshot.state = state;
+            snapshot.printTimers = printRenderTimers;
+            printRenderTimers = false;
+
+            float viewLeft = view2.getCenter().x - view2.getSize().x / 2.0f;
+            snapshotBuilder.build(snapshot, converter::pixelToMeter(viewLeft), converter::pixelToMeter(viewLeft + view2.getSize().x));
+        }
+
+        //waits while the render thread is still drawing the frame before
+        {
+            PROFILE_SCOPE("publish");
+            exchange.publish();
+        }
+
+        //the render thread swaps the buffers, the frame rate limit paces the frames published to it
+        if (options.frameRateLimit > 0)
+        {
+            PROFILE_SCOPE("limiter");
+
+            sf::Time frameDuration = sf::seconds(1.0f / options.frameRateLimit);
+            if (limiterClock.getElapsedTime() < frameDuration)
+            {
+                sf::sleep(frameDuration - limiterClock.getElapsedTime());
+            }
+            limiterClock.restart();
+        }
+    }
+
+    profiler::frameTimers.endFrame();
+
+    exchange.close();
+    renderThread.join();
+    window->close();
+    delete window;
+
+    if (!options.recordPath.empty())
+    {
+        recording.finish(state);
+        if (!replay::saveToFile(options.recordPath, recording))
+        {
+            return 1;
+        }
+    }
+
     return 0;
 }
+
+void printRunSummary(const gameEng::FrameState &state, double elapsedSeconds)
+{
+    std::cout << "result: " << (state.isWon ? "won" : state.isLost ? "lost" : "unfinished") << std::endl;
+    std::cout << "score: " << state.score << std::endl;
+    std::cout << "frames: " << state.frame << std::endl;
+    std::cout << "distance: " << state.originX + state.characterX << " m" << std::endl;
+    std::cout << "elapsed: " << elapsedSeconds * 1000.0 << " ms (" << (elapsedSeconds > 0.0 ? state.frame / elapsedSeconds : 0.0) << " frames/s)" << std::endl;
+}
+
+//run whole games without a window as fast as the CPU allows, e.g. to validate the levels on a machine without a display
+int runHeadless(const LaunchOptions &options, profiler::StepRecorder *stepRecorder)
+{
+    gameEng::Game game(options.viewWidth, options.stepRate, options.seed, options.endless);
+    game.setStepRecorder(stepRecorder);
+    gameEng::FrameState state = game.getFrameState();
+
+    replay::Replay recording;
+    recording.seed = options.seed;
+    recording.viewWidth = options.viewWidth;
+    recording.stepRate = options.stepRate;
+    recording.isEndless = options.endless;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    while (!state.isWon && !state.isLost && state.frame < options.maxFrames)
+    {
+        profiler::frameTimers.endFrame();
+        PROFILE_SCOPE("frame");
+
+        gameEng::FrameInput input;
+
+        //the camera only starts to move once the player is ready, so press up on the very first frame
+        if (state.frame == 0)
+        {
+            input.events.push_back({gameEng::KEY_UP, true});
+            input.events.push_back({gameEng::KEY_UP, false});
+        }
+
+        recording.record(state.frame, input);
+        state = game.step(input);
+    }
+
+    profiler::frameTimers.endFrame();
+
+    double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::cout << "seed: " << options.seed << std::endl;
+    printRunSummary(state, elapsedSeconds);
+
+    if (!options.recordPath.empty())
+    {
+        recording.finish(state);
+        if (!replay::saveToFile(options.recordPath, recording))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//simulate a recorded session again without a window as fast as the CPU allows, and check that it ends in the recorded state
+int runReplay(const LaunchOptions &options, profiler::StepRecorder *stepRecorder)
+{
+    replay::Replay recording;
+    if (!replay::loadFromFile(options.replayPath, recording))
+    {
+        return 1;
+    }
+
+    gameEng::Game game(recording.viewWidth, recording.stepRate, recording.seed, recording.isEndless);
+    game.setStepRecorder(stepRecorder);
+    gameEng::FrameState state = game.getFrameState();
+    size_t nextInput = 0;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    while ((uint32_t)state.frame < recording.frameCount)
+    {
+        profiler::frameTimers.endFrame();
+        PROFILE_SCOPE("frame");
+
+        //feed every key transition recorded on this step
+        gameEng::FrameInput input;
+        while (nextInput < recording.inputs.size() && recording.inputs[nextInput].frame == (uint32_t)state.frame)
+        {
+            input.events.push_back({recording.inputs[nextInput].key, recording.inputs[nextInput].isPressed});
+            nextInput++;
+        }
+
+        state = game.step(input);
+    }
+
+    profiler::frameTimers.endFrame();
+
+    double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    printRunSummary(state, elapsedSeconds);
+
+    replay::Replay playback;
+    playback.finish(state);
+    if (playback.score != recording.score || playback.result != recording.result)
+    {
+        std::cerr << "replay diverged: recorded score " << recording.score << " and result " << (int)recording.result << std::endl;
+        return 2;
+    }
+
+    return 0;
+}
+
+void printUsage(const char *program)
+{
+    std::cerr << "usage: " << program << " [--headless] [--width <pixel>] [--frames <count>] [--hz <steps per second>] [--fps <frames per second>] [--seed <number>] [--record <file>] [--replay <file>] [--profile] [--profile-csv <file>] [--profile-json <file>] [--timers] [--trace <file>] [--endless]" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    LaunchOptions options;
+    bool hasSeed = false;
+
+    //read the command line options, a value that is not a number is handled like an unknown option
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+
+            if (arg == "--headless")
+            {
+                options.headless = true;
+            }
+            else if (arg == "--width" && i + 1 < argc)
+            {
+                options.viewWidth = std::stof(argv[++i]);
+            }
+            else if (arg == "--frames" && i + 1 < argc)
+            {
+                options.maxFrames = std::stoi(argv[++i]);
+            }
+            else if (arg == "--hz" && i + 1 < argc)
+            {
+                options.stepRate = std::stof(argv[++i]);
+            }
+            else if (arg == "--fps" && i + 1 < argc)
+            {
+                options.frameRateLimit = std::stoi(argv[++i]);
+            }
+            else if (arg == "--seed" && i + 1 < argc)
+            {
+                options.seed = std::stoul(argv[++i]);
+                hasSeed = true;
+            }
+            else if (arg == "--record" && i + 1 < argc)
+            {
+                options.recordPath = argv[++i];
+            }
+            else if (arg == "--replay" && i + 1 < argc)
+            {
+                options.replayPath = argv[++i];
+            }
+            else if (arg == "--profile")
+            {
+                options.profile = true;
+            }
+            else if (arg == "--profile-csv" && i + 1 < argc)
+            {
+                options.profileCsvPath = argv[++i];
+            }
+            else if (arg == "--profile-json" && i + 1 < argc)
+            {
+                options.profileJsonPath = argv[++i];
+            }
+            else if (arg == "--timers")
+            {
+                options.timers = true;
+            }
+            else if (arg == "--trace" && i + 1 < argc)
+            {
+                options.tracePath = argv[++i];
+            }
+            else if (arg == "--endless")
+            {
+                options.endless = true;
+            }
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        //std::invalid_argument and std::out_of_range of the number conversions
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (options.stepRate <= 0.0f)
+    {
+        std::cerr << "the step rate must be larger than 0" << std::endl;
+        return 1;
+    }
+
+    //without a given seed every game gets a different level, the seed is kept in the recording to rebuild it
+    if (!hasSeed)
+    {
+        std::random_device rd;
+        options.seed = rd();
+    }
+
+    //keep the b2Profile of the latest steps, about 18 minutes of play at 60 steps per second
+    std::unique_ptr<profiler::StepRecorder> stepRecorder;
+    if (options.profile || !options.profileCsvPath.empty() || !options.profileJsonPath.empty())
+    {
+        stepRecorder.reset(new profiler::StepRecorder(1 << 16));
+    }
+
+    profiler::frameTimers.setEnabled(options.timers);
+    profiler::renderTimers.setEnabled(options.timers);
+    profiler::traceRecorder.setEnabled(!options.tracePath.empty());
+    profiler::traceRecorder.setThreadName("main");
+
+    int exitCode = 0;
+    if (!options.replayPath.empty())
+    {
+        exitCode = runReplay(options, stepRecorder.get());
+    }
+    else if (options.headless)
+    {
+        exitCode = runHeadless(options, stepRecorder.get());
+    }
+    else
+    {
+        exitCode = runWindowed(options, stepRecorder.get());
+    }
+
+    if (options.timers)
+    {
+        profiler::frameTimers.printReport(std::cout);
+        if (profiler::renderTimers.getFrameCount() > 0)
+        {
+            std::cout << "render thread ";
+            profiler::renderTimers.printReport(std::cout);
+        }
+    }
+
+    //a trace started with F2 is written even without --trace
+    if (profiler::traceRecorder.getEventCount() > 0 && !profiler::traceRecorder.exportJson(options.tracePath.empty() ? "trace.json" : options.tracePath))
+    {
+        exitCode = 1;
+    }
+
+    if (stepRecorder)
+    {
+        if (options.profile)
+        {
+            profiler::printStepReport(*stepRecorder, std::cout);
+        }
+        if (!options.profileCsvPath.empty() && !profiler::exportStepsCsv(*stepRecorder, options.profileCsvPath))
+        {
+            exitCode = 1;
+        }
+        if (!options.profileJsonPath.empty() && !profiler::exportStepsJson(*stepRecorder, options.profileJsonPath))
+        {
+            exitCode = 1;
+        }
+    }
+
+    return exitCode;
+}